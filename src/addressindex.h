@@ -263,6 +263,46 @@ struct CAddressIndexIteratorHeightKey {
     }
 };
 
+/**
+ * Running totals of the address index entries of one address, so its
+ * balance is read without scanning its history. It is keyed by a
+ * CAddressIndexIteratorKey and kept in step with the entries as blocks are
+ * connected and disconnected. lastHeight is the height of the latest block
+ * with entries for the address, which tells whether a block was already
+ * added to the totals.
+ */
+struct CAddressBalanceValue {
+    CAmount balance;
+    CAmount received;
+    uint64_t txCount;
+    int lastHeight;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(balance);
+        READWRITE(received);
+        READWRITE(VARINT(txCount));
+        READWRITE(lastHeight);
+    }
+
+    CAddressBalanceValue() {
+        SetNull();
+    }
+
+    void SetNull() {
+        balance = 0;
+        received = 0;
+        txCount = 0;
+        lastHeight = -1;
+    }
+
+    bool IsNull() const {
+        return txCount == 0;
+    }
+};
+
 struct CMempoolAddressDelta
 {
     int64_t time;
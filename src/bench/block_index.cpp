@@ -0,0 +1,115 @@
+// Copyright (c) 2017-2018 The Merit Foundation developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+#include "chain.h"
+#include "chainparams.h"
+#include "checkqueue.h"
+#include "cuckoo/miner.h"
+#include "streams.h"
+#include "util.h"
+#include "validation.h"
+#include "version.h"
+
+#include <memory>
+#include <vector>
+
+#include <boost/thread/thread.hpp>
+
+// Checking the proofs of work of the block index at startup. Every iteration
+// checks a chain worth of entries, all copies of the main network genesis
+// block, which has a valid proof.
+namespace
+{
+    const size_t ENTRIES = 10000;
+    const size_t BATCH_SIZE = 256;
+    const int MIN_CORES = 2;
+
+    struct BlockIndexBenchSetup
+    {
+        uint256 hash;
+        std::vector<std::unique_ptr<CBlockIndex>> entries;
+
+        BlockIndexBenchSetup()
+        {
+            SelectParams(CBaseChainParams::MAIN);
+            const auto& genesis = Params().GenesisBlock();
+            hash = genesis.GetHash();
+
+            for (size_t i = 0; i < ENTRIES; i++) {
+                entries.emplace_back(new CBlockIndex{genesis});
+                entries.back()->phashBlock = &hash;
+            }
+        }
+    };
+}
+
+// One entry at a time on one thread, as the index used to be checked.
+static void BlockIndexProofOfWorkSerial(benchmark::State& state)
+{
+    BlockIndexBenchSetup setup;
+    const auto& params = Params().GetConsensus();
+
+    while (state.KeepRunning()) {
+        for (const auto& pindex : setup.entries) {
+            assert(cuckoo::VerifyProofOfWork(
+                        pindex->GetBlockHash(),
+                        pindex->nBits,
+                        pindex->nEdgeBits,
+                        pindex->sCycle,
+                        params));
+        }
+    }
+}
+
+// Batches of entries on all cores, as LoadBlockIndexDB checks them.
+static void BlockIndexProofOfWorkParallel(benchmark::State& state)
+{
+    BlockIndexBenchSetup setup;
+    const auto& params = Params().GetConsensus();
+
+    CCheckQueue<CProofOfWorkCheck> queue{1};
+    boost::thread_group tg;
+    for (auto x = 0; x < std::max(MIN_CORES, GetNumCores()) - 1; ++x) {
+       tg.create_thread([&]{queue.Thread();});
+    }
+
+    while (state.KeepRunning()) {
+        CCheckQueueControl<CProofOfWorkCheck> control(&queue);
+        for (size_t i = 0; i < setup.entries.size(); i += BATCH_SIZE) {
+            std::vector<const CBlockIndex*> batch;
+            for (size_t j = i; j < std::min(i + BATCH_SIZE, setup.entries.size()); j++) {
+                batch.push_back(setup.entries[j].get());
+            }
+
+            std::vector<CProofOfWorkCheck> vChecks(1);
+            CProofOfWorkCheck(std::move(batch), params).swap(vChecks[0]);
+            control.Add(vChecks);
+        }
+        assert(control.Wait());
+    }
+    tg.interrupt_all();
+    tg.join_all();
+}
+
+// Reading entries back from the block tree DB, which is most of what
+// LoadBlockIndexGuts does per entry besides allocating the CBlockIndex.
+static void BlockIndexUnserialize(benchmark::State& state)
+{
+    BlockIndexBenchSetup setup;
+
+    CDataStream stream(SER_DISK, CLIENT_VERSION);
+    stream << CDiskBlockIndex{setup.entries.front().get()};
+
+    while (state.KeepRunning()) {
+        CDataStream entry{stream};
+        CDiskBlockIndex diskindex;
+        entry >> diskindex;
+        assert(diskindex.sCycle.size() == Params().GetConsensus().nCuckooProofSize);
+    }
+}
+
+BENCHMARK(BlockIndexProofOfWorkSerial);
+BENCHMARK(BlockIndexProofOfWorkParallel);
+BENCHMARK(BlockIndexUnserialize);
@@ -0,0 +1,101 @@
+// Copyright (c) 2017-2018 The Merit Foundation developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+#include "chain.h"
+#include "chainparams.h"
+#include "fs.h"
+#include "random.h"
+#include "streams.h"
+#include "util.h"
+#include "utiltime.h"
+#include "validation.h"
+
+#include <vector>
+
+// Reading a block to serve it to a peer. The block is the main network
+// genesis block, which is small enough for the proof of work check to be
+// most of what reading it costs, written to a block file in a temporary
+// data directory the way WriteBlockToDisk does.
+namespace
+{
+    struct BlockReadBenchSetup
+    {
+        fs::path path;
+        uint256 hash;
+        CBlockIndex index;
+
+        BlockReadBenchSetup()
+        {
+            SelectParams(CBaseChainParams::MAIN);
+            ClearDatadirCache();
+            path = fs::temp_directory_path() / strprintf("bench_merit_%lu_%i", (unsigned long)GetTime(), (int)GetRand(100000));
+            fs::create_directories(path);
+            gArgs.ForceSetArg("-datadir", path.string());
+
+            const auto& genesis = Params().GenesisBlock();
+            hash = genesis.GetHash();
+
+            CDiskBlockPos pos{0, 0};
+            CAutoFile fileout(OpenBlockFile(pos), SER_DISK, CLIENT_VERSION);
+            assert(!fileout.IsNull());
+            fileout << FLATDATA(Params().MessageStart()) << static_cast<unsigned int>(GetSerializeSize(fileout, genesis));
+            pos.nPos = ftell(fileout.Get());
+            fileout << genesis;
+            fileout.fclose();
+
+            index = CBlockIndex{genesis};
+            index.phashBlock = &hash;
+            index.nFile = pos.nFile;
+            index.nDataPos = pos.nPos;
+            index.nStatus = BLOCK_VALID_TRANSACTIONS | BLOCK_HAVE_DATA;
+        }
+
+        ~BlockReadBenchSetup()
+        {
+            ClearDatadirCache();
+            fs::remove_all(path);
+        }
+    };
+}
+
+// Reading by position, checking the proof of work again as every read of a
+// validated block used to.
+static void BlockReadCheckProofOfWork(benchmark::State& state)
+{
+    BlockReadBenchSetup setup;
+    const auto& params = Params().GetConsensus();
+
+    while (state.KeepRunning()) {
+        CBlock block;
+        assert(ReadBlockFromDisk(block, setup.index.GetBlockPos(), params));
+    }
+}
+
+// Reading through the index entry, which trusts its validity.
+static void BlockReadTrustIndex(benchmark::State& state)
+{
+    BlockReadBenchSetup setup;
+    const auto& params = Params().GetConsensus();
+
+    while (state.KeepRunning()) {
+        CBlock block;
+        assert(ReadBlockFromDisk(block, &setup.index, params));
+    }
+}
+
+// Reading the bytes on disk, as witness blocks are served to peers.
+static void BlockReadRaw(benchmark::State& state)
+{
+    BlockReadBenchSetup setup;
+
+    while (state.KeepRunning()) {
+        std::vector<uint8_t> block;
+        assert(ReadRawBlockFromDisk(block, &setup.index, Params().MessageStart()));
+    }
+}
+
+BENCHMARK(BlockReadCheckProofOfWork);
+BENCHMARK(BlockReadTrustIndex);
+BENCHMARK(BlockReadRaw);
@@ -0,0 +1,194 @@
+// Copyright (c) 2017-2018 The Merit Foundation developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+#include "arith_uint256.h"
+#include "chainparams.h"
+#include "cuckoo/cuckoo.h"
+#include "cuckoo/mean_cuckoo.h"
+#include "cuckoo/miner.h"
+#include "util.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <set>
+#include <vector>
+
+#ifndef WIN32
+#include <sys/resource.h>
+#endif
+
+// Proof-of-work benches. Every iteration of the solver benches is one graph,
+// so graphs per second is the inverse of the reported average. After each
+// solver bench its graphs per second, memory and trimming timings are
+// printed on a line starting with '#'.
+//
+// Graphs above 24 edge bits take gigabytes and seconds per graph, so they
+// only run if MERIT_BENCH_CUCKOO_EDGE_BITS is set to a larger limit.
+namespace
+{
+    const uint8_t PROOF_SIZE = 42;
+    const uint8_t DEFAULT_MAX_EDGE_BITS = 24;
+
+    uint8_t MaxEdgeBits()
+    {
+        const char* limit = std::getenv("MERIT_BENCH_CUCKOO_EDGE_BITS");
+        return limit ? std::atoi(limit) : DEFAULT_MAX_EDGE_BITS;
+    }
+
+    uint256 GraphHash(uint32_t graph)
+    {
+        return ArithToUint256(arith_uint256{graph});
+    }
+
+    // Peak resident set size of the whole process in MiB
+    int64_t PeakRSS()
+    {
+#ifndef WIN32
+        struct rusage usage;
+        if (getrusage(RUSAGE_SELF, &usage) == 0) {
+#ifdef __APPLE__
+            return usage.ru_maxrss >> 20;
+#else
+            return usage.ru_maxrss >> 10;
+#endif
+        }
+#endif
+        return -1;
+    }
+
+    void PrintSolverStats(uint8_t edgeBits, const cuckoo::Solver& solver)
+    {
+        const auto stats = solver.Stats();
+        if (stats.graphs == 0) {
+            return;
+        }
+
+        const double graphs = stats.graphs;
+        const double seconds = (stats.trimMicros + stats.cycleMicros) / 1e6;
+
+        std::cout << strprintf(
+                "# cuckoo%d x%d: %.3f graphs/s, solver %u MiB, peak RSS %d MiB, "
+                "trimming %.3f ms, cycle search %.3f ms, rounds (us):",
+                edgeBits,
+                solver.Threads(),
+                seconds > 0 ? graphs / seconds : 0.,
+                solver.MemoryUsage() >> 20,
+                PeakRSS(),
+                stats.trimMicros / graphs / 1e3,
+                stats.cycleMicros / graphs / 1e3);
+
+        for (const auto micros : stats.roundMicros) {
+            std::cout << strprintf(" %.0f", micros / graphs);
+        }
+        std::cout << "\n";
+    }
+
+    void FindCycleAdvancedBench(benchmark::State& state, uint8_t edgeBits, bool allCores)
+    {
+        if (edgeBits > MaxEdgeBits()) {
+            return;
+        }
+
+        const size_t threads = allCores ? std::max(2, GetNumCores()) : 1;
+        auto solver = cuckoo::MakeSolver(edgeBits, PROOF_SIZE, threads);
+
+        uint32_t graph = 0;
+        while (state.KeepRunning()) {
+            cuckoo::Cycle cycle;
+            solver->Solve(GraphHash(graph++), cycle);
+        }
+
+        PrintSolverStats(edgeBits, *solver);
+    }
+
+    void FindCycleBench(benchmark::State& state, uint8_t edgeBits)
+    {
+        uint32_t graph = 0;
+        while (state.KeepRunning()) {
+            cuckoo::Cycle cycle;
+            FindCycle(GraphHash(graph++), edgeBits, PROOF_SIZE, cycle);
+        }
+    }
+}
+
+static void CuckooFindCycle16(benchmark::State& state) { FindCycleBench(state, 16); }
+static void CuckooFindCycle20(benchmark::State& state) { FindCycleBench(state, 20); }
+
+BENCHMARK(CuckooFindCycle16);
+BENCHMARK(CuckooFindCycle20);
+
+// CuckooFindCycleAdvanced<edge bits>x1 uses one thread and
+// CuckooFindCycleAdvanced<edge bits>xN one thread per core.
+#define CUCKOO_ADVANCED_BENCH(bits)                                       \
+    static void CuckooFindCycleAdvanced##bits##x1(benchmark::State& state) \
+    {                                                                     \
+        FindCycleAdvancedBench(state, bits, false);                       \
+    }                                                                     \
+    static void CuckooFindCycleAdvanced##bits##xN(benchmark::State& state) \
+    {                                                                     \
+        FindCycleAdvancedBench(state, bits, true);                        \
+    }                                                                     \
+    BENCHMARK(CuckooFindCycleAdvanced##bits##x1);                         \
+    BENCHMARK(CuckooFindCycleAdvanced##bits##xN);
+
+CUCKOO_ADVANCED_BENCH(16)
+CUCKOO_ADVANCED_BENCH(17)
+CUCKOO_ADVANCED_BENCH(18)
+CUCKOO_ADVANCED_BENCH(19)
+CUCKOO_ADVANCED_BENCH(20)
+CUCKOO_ADVANCED_BENCH(21)
+CUCKOO_ADVANCED_BENCH(22)
+CUCKOO_ADVANCED_BENCH(23)
+CUCKOO_ADVANCED_BENCH(24)
+CUCKOO_ADVANCED_BENCH(25)
+CUCKOO_ADVANCED_BENCH(26)
+CUCKOO_ADVANCED_BENCH(27)
+CUCKOO_ADVANCED_BENCH(28)
+CUCKOO_ADVANCED_BENCH(29)
+
+// The main network genesis block is a fixed header with a valid proof.
+static void CuckooVerifyCycle(benchmark::State& state)
+{
+    SelectParams(CBaseChainParams::MAIN);
+    const auto& genesis = Params().GenesisBlock();
+    const uint256 hash = genesis.GetHash();
+
+    while (state.KeepRunning()) {
+        assert(VerifyCycle(hash, genesis.nEdgeBits, PROOF_SIZE, genesis.sCycle) == POW_OK);
+    }
+}
+
+static void CuckooVerifyProofOfWork(benchmark::State& state)
+{
+    SelectParams(CBaseChainParams::MAIN);
+    const auto& genesis = Params().GenesisBlock();
+    const auto& params = Params().GetConsensus();
+    const uint256 hash = genesis.GetHash();
+
+    while (state.KeepRunning()) {
+        assert(cuckoo::VerifyProofOfWork(hash, genesis.nBits, genesis.nEdgeBits, genesis.sCycle, params));
+    }
+}
+
+// A full headers message worth of proofs checked in one batch.
+static void CuckooVerifyProofsOfWork(benchmark::State& state)
+{
+    SelectParams(CBaseChainParams::MAIN);
+    const auto& genesis = Params().GenesisBlock();
+    const auto& params = Params().GetConsensus();
+    const cuckoo::ProofOfWork proof{genesis.GetHash(), genesis.nBits, genesis.nEdgeBits, &genesis.sCycle};
+    const std::vector<cuckoo::ProofOfWork> proofs(2000, proof);
+
+    while (state.KeepRunning()) {
+        const auto valid = cuckoo::VerifyProofsOfWork(proofs, params);
+        assert(std::all_of(valid.begin(), valid.end(), [](bool v) { return v; }));
+    }
+}
+
+BENCHMARK(CuckooVerifyCycle);
+BENCHMARK(CuckooVerifyProofOfWork);
+BENCHMARK(CuckooVerifyProofsOfWork);
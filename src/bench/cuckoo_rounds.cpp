@@ -0,0 +1,100 @@
+// Copyright (c) 2017-2018 The Merit Foundation developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+#include "ctpl/ctpl.h"
+#include "cuckoo/solver_team.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Synchronization overhead of the mean solver, without any trimming work.
+// One iteration is a graph worth of rounds, so the per-round overhead is
+// the reported time divided by TRIM_ROUNDS.
+namespace
+{
+    const size_t TRIM_ROUNDS = 68;
+
+    size_t TeamThreads()
+    {
+        return std::max(2u, std::min(8u, std::thread::hardware_concurrency()));
+    }
+
+    // The mutex and condition variable barrier the solver used before.
+    class MutexBarrier
+    {
+    public:
+        explicit MutexBarrier(size_t nThreadsIn) : nThreads{nThreadsIn}, nCount{nThreadsIn} {}
+
+        void Wait()
+        {
+            std::unique_lock<std::mutex> lLock{mMutex};
+            auto lGen = nGeneration;
+            if (!--nCount) {
+                nGeneration++;
+                nCount = nThreads;
+                cv.notify_all();
+            } else {
+                cv.wait(lLock, [this, lGen] { return lGen != nGeneration; });
+            }
+        }
+
+    private:
+        std::mutex mMutex;
+        std::condition_variable cv;
+        size_t nThreads;
+        size_t nCount;
+        size_t nGeneration = 0;
+    };
+}
+
+// Every graph pushes a job per thread onto a thread pool and rounds are
+// separated by a mutex barrier.
+static void CuckooTrimRoundsThreadPool(benchmark::State& state)
+{
+    const size_t threads = TeamThreads();
+    ctpl::thread_pool pool{static_cast<int>(threads)};
+    MutexBarrier barrier{threads};
+
+    while (state.KeepRunning()) {
+        std::vector<std::future<void>> jobs;
+        for (size_t t = 0; t < threads; t++) {
+            jobs.push_back(pool.push([&barrier](int id) {
+                for (size_t round = 0; round < TRIM_ROUNDS; round++) {
+                    barrier.Wait();
+                }
+            }));
+        }
+
+        for (auto& j : jobs) {
+            j.wait();
+        }
+    }
+}
+
+// Every graph flips the phase of a persistent team and rounds are separated
+// by a spinning barrier.
+static void CuckooTrimRoundsSolverTeam(benchmark::State& state)
+{
+    const size_t threads = TeamThreads();
+    cuckoo::SolverTeam team{threads};
+    cuckoo::SpinBarrier barrier{threads, cuckoo::DefaultSpins(threads)};
+
+    const cuckoo::SolverTeam::Job job = [&barrier](uint32_t id) {
+        for (size_t round = 0; round < TRIM_ROUNDS; round++) {
+            barrier.Wait();
+        }
+    };
+
+    while (state.KeepRunning()) {
+        team.Run(job);
+    }
+}
+
+BENCHMARK(CuckooTrimRoundsThreadPool);
+BENCHMARK(CuckooTrimRoundsSolverTeam);
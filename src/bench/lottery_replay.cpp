@@ -0,0 +1,149 @@
+// Copyright (c) 2017-2018 The Merit Foundation developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench/lottery_sim.h"
+#include "crypto/sha256.h"
+#include "random.h"
+#include "util.h"
+#include "utilstrencodings.h"
+#include "utiltime.h"
+
+#include <iostream>
+
+static const size_t DEFAULT_BLOCKS = 100;
+
+static void PrintUsage()
+{
+    const benchmark::LotterySimOptions defaults;
+
+    std::string usage = "Usage:\n  lottery_replay [options]\n\n";
+    usage += HelpMessageGroup("Options:");
+    usage += HelpMessageOpt("-?", "This help message");
+    usage += HelpMessageOpt("-blocks=<n>", strprintf("Number of blocks to connect (default: %u)", DEFAULT_BLOCKS));
+    usage += HelpMessageOpt("-treesize=<n>", strprintf("Number of referrals in the network (default: %u)", defaults.tree_size));
+    usage += HelpMessageOpt("-maxdepth=<n>", strprintf("Maximum depth of the referral tree (default: %u)", defaults.max_depth));
+    usage += HelpMessageOpt("-maxchildren=<n>", strprintf("Maximum referrals invited by one address (default: %u)", defaults.max_children));
+    usage += HelpMessageOpt("-changes=<n>", strprintf("Debits and credits per block (default: %u)", defaults.changes_per_block));
+    usage += HelpMessageOpt("-reservoir=<n>", strprintf("Size of the lottery reservoir (default: %u)", defaults.reservoir_size));
+    usage += HelpMessageOpt("-height=<n>", strprintf("Height of the first block (default: %d)", defaults.start_height));
+    usage += HelpMessageOpt("-flushinterval=<n>", strprintf("Flush the referral DB every n blocks (default: %u)", defaults.flush_interval));
+    usage += HelpMessageOpt("-seed=<hex>", "Seed of the network and blocks (default: 0)");
+    fprintf(stdout, "%s", usage.c_str());
+}
+
+static bool ReadSize(const std::string& arg, size_t default_value, size_t& value)
+{
+    const auto v = gArgs.GetArg(arg, static_cast<int64_t>(default_value));
+    if (v <= 0) {
+        fprintf(stderr, "Error: %s must be positive\n", arg.c_str());
+        return false;
+    }
+    value = static_cast<size_t>(v);
+    return true;
+}
+
+/**
+ * Replays a stream of synthetic blocks against an in-memory referral DB and
+ * prints what every block cost the lottery, so changes to the referral DB
+ * can be measured on networks of any shape. The same options always replay
+ * the same blocks.
+ */
+static int ReplayLottery(int argc, char* argv[])
+{
+    gArgs.ParseParameters(argc, argv);
+
+    if (gArgs.IsArgSet("-?") || gArgs.IsArgSet("-h") || gArgs.IsArgSet("-help")) {
+        PrintUsage();
+        return EXIT_SUCCESS;
+    }
+
+    benchmark::LotterySimOptions options;
+    size_t blocks;
+    size_t reservoir_size;
+    if (!ReadSize("-blocks", DEFAULT_BLOCKS, blocks) ||
+            !ReadSize("-treesize", options.tree_size, options.tree_size) ||
+            !ReadSize("-maxdepth", options.max_depth, options.max_depth) ||
+            !ReadSize("-maxchildren", options.max_children, options.max_children) ||
+            !ReadSize("-changes", options.changes_per_block, options.changes_per_block) ||
+            !ReadSize("-reservoir", options.reservoir_size, reservoir_size) ||
+            !ReadSize("-flushinterval", options.flush_interval, options.flush_interval)) {
+        return EXIT_FAILURE;
+    }
+    options.reservoir_size = reservoir_size;
+    options.start_height = gArgs.GetArg("-height", options.start_height);
+
+    const auto seed = gArgs.GetArg("-seed", "");
+    if (!seed.empty() && !IsHex(seed)) {
+        fprintf(stderr, "Error: -seed must be hex\n");
+        return EXIT_FAILURE;
+    }
+    options.seed = uint256S(seed);
+
+    const int64_t setup_start = GetTimeMicros();
+    benchmark::LotterySim sim{options};
+    std::cerr << strprintf("Built a network of %u referrals in %.2fs\n",
+            sim.TreeSize(), (GetTimeMicros() - setup_start) * 0.000001);
+
+    std::cout << "# height,reward_ms,anv_ms,lottery_ms,flush_ms,reads,disk_reads,writes,lottery_undos,winners\n";
+
+    benchmark::LotteryBlockStats total;
+    for (size_t b = 0; b < blocks; b++) {
+        benchmark::LotteryBlockStats stats;
+        if (!sim.ConnectBlock(sim.NextBlock(), stats)) {
+            fprintf(stderr, "Error: failed to connect block %d\n", stats.height);
+            return EXIT_FAILURE;
+        }
+
+        std::cout << strprintf("%d,%.3f,%.3f,%.3f,%.3f,%u,%u,%u,%u,%u\n",
+                stats.height,
+                stats.reward_micros * 0.001,
+                stats.anv_micros * 0.001,
+                stats.lottery_micros * 0.001,
+                stats.flush_micros * 0.001,
+                stats.db.reads,
+                stats.db.disk_reads,
+                stats.db.writes,
+                stats.lottery_undos,
+                stats.winners);
+
+        total.reward_micros += stats.reward_micros;
+        total.anv_micros += stats.anv_micros;
+        total.lottery_micros += stats.lottery_micros;
+        total.flush_micros += stats.flush_micros;
+        total.db.reads += stats.db.reads;
+        total.db.disk_reads += stats.db.disk_reads;
+        total.db.writes += stats.db.writes;
+        total.lottery_undos += stats.lottery_undos;
+    }
+
+    const double n = blocks;
+    std::cout << strprintf("# average,%.3f,%.3f,%.3f,%.3f,%.1f,%.1f,%.1f,%.1f\n",
+            total.reward_micros * 0.001 / n,
+            total.anv_micros * 0.001 / n,
+            total.lottery_micros * 0.001 / n,
+            total.flush_micros * 0.001 / n,
+            total.db.reads / n,
+            total.db.disk_reads / n,
+            total.db.writes / n,
+            total.lottery_undos / n);
+
+    return EXIT_SUCCESS;
+}
+
+int main(int argc, char* argv[])
+{
+    SHA256AutoDetect();
+    RandomInit();
+    SetupEnvironment();
+    fPrintToDebugLog = false; // don't want to write to debug.log file
+
+    try {
+        return ReplayLottery(argc, argv);
+    } catch (const std::exception& e) {
+        PrintExceptionContinue(&e, "ReplayLottery()");
+    } catch (...) {
+        PrintExceptionContinue(nullptr, "ReplayLottery()");
+    }
+    return EXIT_FAILURE;
+}
@@ -0,0 +1,211 @@
+// Copyright (c) 2017-2018 The Merit Foundation developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench/lottery_sim.h"
+#include "bench/referral_util.h"
+
+#include "chainparams.h"
+#include "hash.h"
+#include "util.h"
+#include "utiltime.h"
+
+#include <algorithm>
+
+namespace benchmark
+{
+    namespace
+    {
+        const size_t POPULAR_AMBASSADORS = 50;
+        const uint64_t MAX_CREDIT = 1000000;
+
+        referral::ReferralsDBStats operator-(
+                const referral::ReferralsDBStats& a,
+                const referral::ReferralsDBStats& b)
+        {
+            referral::ReferralsDBStats d;
+            d.reads = a.reads - b.reads;
+            d.disk_reads = a.disk_reads - b.disk_reads;
+            d.writes = a.writes - b.writes;
+            return d;
+        }
+    }
+
+    LotterySim::LotterySim(const LotterySimOptions& options) :
+        m_options{options},
+        m_rng{options.seed},
+        m_height{options.start_height}
+    {
+        assert(m_options.tree_size > 0);
+        assert(m_options.max_children > 0);
+        assert(m_options.flush_interval > 0);
+
+        SelectParams(CBaseChainParams::MAIN);
+        ClearDatadirCache();
+        m_path = fs::temp_directory_path() / strprintf("bench_merit_%lu_%i", (unsigned long)GetTime(), (int)GetRand(100000));
+        fs::create_directories(m_path);
+        gArgs.ForceSetArg("-datadir", m_path.string());
+
+        m_db.reset(new referral::ReferralsViewDB{0, true, true, "benchreferrals"});
+        m_cache.reset(new referral::ReferralsViewCache{m_db.get()});
+
+        BuildTree();
+
+        m_prev_hash = m_rng.rand256();
+        m_db->Flush(m_prev_hash);
+
+        prefviewdb = m_db.get();
+        prefviewcache = m_cache.get();
+    }
+
+    LotterySim::~LotterySim()
+    {
+        prefviewcache = nullptr;
+        prefviewdb = nullptr;
+        m_cache.reset();
+        m_db.reset();
+        ClearDatadirCache();
+        fs::remove_all(m_path);
+    }
+
+    /**
+     * Half the referrals go to one of the first ambassadors still taking
+     * invites and the rest to any of them. A referral stops taking invites
+     * once it has max_children or sits at max_depth, and the tree stops
+     * growing early if no referral can take any more.
+     */
+    void LotterySim::BuildTree()
+    {
+        std::vector<size_t> depths;
+        std::vector<size_t> children;
+        std::vector<size_t> open;
+
+        for (size_t i = 0; i < m_options.tree_size; i++) {
+            referral::Address parent;
+            size_t depth = 0;
+            if (i > 0) {
+                if (open.empty()) {
+                    break;
+                }
+
+                const auto open_idx = m_rng.randbool() ?
+                    m_rng.randrange(std::min(open.size(), POPULAR_AMBASSADORS)) :
+                    m_rng.randrange(open.size());
+                const auto parent_idx = open[open_idx];
+
+                if (++children[parent_idx] == m_options.max_children) {
+                    open[open_idx] = open.back();
+                    open.pop_back();
+                }
+
+                parent = m_addresses[parent_idx];
+                depth = depths[parent_idx] + 1;
+            }
+
+            referral::Address address;
+            const auto address_bytes = m_rng.randbytes(address.size());
+            std::copy(address_bytes.begin(), address_bytes.end(), address.begin());
+
+            m_db->InsertReferral(MakeReferral(m_rng, address, parent), i == 0, false);
+
+            CAmount confirmations;
+            m_db->UpdateConfirmation(1, address, 1, confirmations);
+
+            if (depth < m_options.max_depth) {
+                open.push_back(m_addresses.size());
+            }
+
+            m_addresses.push_back(address);
+            m_balances.push_back(0);
+            depths.push_back(depth);
+            children.push_back(0);
+        }
+    }
+
+    DebitsAndCredits LotterySim::NextBlock()
+    {
+        DebitsAndCredits debits_and_credits;
+        debits_and_credits.reserve(m_options.changes_per_block);
+
+        for (size_t c = 0; c < m_options.changes_per_block; c++) {
+            const auto idx = m_rng.randrange(m_addresses.size());
+            auto& balance = m_balances[idx];
+
+            const CAmount amount = balance > 0 && m_rng.randrange(4) == 0 ?
+                -static_cast<CAmount>(1 + m_rng.randrange(balance)) :
+                static_cast<CAmount>(1 + m_rng.randrange(MAX_CREDIT));
+
+            balance += amount;
+            debits_and_credits.emplace_back(1, m_addresses[idx], amount);
+        }
+
+        return debits_and_credits;
+    }
+
+    bool LotterySim::ConnectBlock(const DebitsAndCredits& debits_and_credits, LotteryBlockStats& stats)
+    {
+        const auto& params = Params().GetConsensus();
+        const auto block_hash = m_rng.rand256();
+        const auto db_start = m_db->GetStats();
+
+        stats = LotteryBlockStats{};
+        stats.height = m_height;
+
+        const int64_t start = GetTimeMicros();
+
+        const auto lottery = RewardAmbassadors(
+                m_height,
+                m_prev_hash,
+                GetSplitSubsidy(m_height, params).ambassador,
+                params);
+        stats.winners = lottery.winners.size();
+
+        const int64_t rewarded = GetTimeMicros();
+
+        if (!m_db->UpdateANVs(debits_and_credits)) {
+            return false;
+        }
+
+        const int64_t anvs_updated = GetTimeMicros();
+
+        //the same hash chain UpdateLotteryEntrants samples with.
+        auto hash = block_hash;
+        for (const auto& t : debits_and_credits) {
+            CHashWriter hasher{SER_DISK, CLIENT_VERSION};
+            hasher << hash << std::get<1>(t);
+            hash = hasher.GetHash();
+
+            referral::LotteryUndos undos;
+            if (!m_db->AddAddressToLottery(
+                        m_height,
+                        hash,
+                        std::get<0>(t),
+                        std::get<1>(t),
+                        m_options.reservoir_size,
+                        undos)) {
+                return false;
+            }
+            stats.lottery_undos += undos.size();
+        }
+
+        const int64_t entrants_added = GetTimeMicros();
+
+        if (static_cast<size_t>(m_height - m_options.start_height + 1) % m_options.flush_interval == 0) {
+            if (!m_db->Flush(block_hash)) {
+                return false;
+            }
+        }
+
+        const int64_t flushed = GetTimeMicros();
+
+        stats.reward_micros = rewarded - start;
+        stats.anv_micros = anvs_updated - rewarded;
+        stats.lottery_micros = entrants_added - anvs_updated;
+        stats.flush_micros = flushed - entrants_added;
+        stats.db = m_db->GetStats() - db_start;
+
+        m_prev_hash = block_hash;
+        m_height++;
+        return true;
+    }
+}
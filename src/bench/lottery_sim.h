@@ -0,0 +1,93 @@
+// Copyright (c) 2017-2018 The Merit Foundation developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef MERIT_BENCH_LOTTERY_SIM_H
+#define MERIT_BENCH_LOTTERY_SIM_H
+
+#include "amount.h"
+#include "fs.h"
+#include "random.h"
+#include "refdb.h"
+#include "referrals.h"
+#include "validation.h"
+
+#include <memory>
+#include <vector>
+
+namespace benchmark
+{
+    struct LotterySimOptions
+    {
+        size_t tree_size = 20000;
+        size_t max_depth = 20;
+        size_t max_children = 1000;
+        size_t changes_per_block = 2000;
+        uint64_t reservoir_size = 10000;
+        int start_height = 50000;
+        size_t flush_interval = 1;
+        uint256 seed;
+    };
+
+    /**
+     * What one block cost the referral DB. Times are in microseconds and the
+     * DB counters only cover the block.
+     */
+    struct LotteryBlockStats
+    {
+        int height = 0;
+        int64_t reward_micros = 0;
+        int64_t anv_micros = 0;
+        int64_t lottery_micros = 0;
+        int64_t flush_micros = 0;
+        referral::ReferralsDBStats db;
+        size_t lottery_undos = 0;
+        size_t winners = 0;
+    };
+
+    /**
+     * A synthetic referral network in an in-memory referral DB, along with a
+     * deterministic stream of blocks of debits and credits. Connecting a
+     * block does what ConnectBlock does to the referral DB: it picks the
+     * ambassadors to reward from the reservoir, applies the ANV changes and
+     * offers every changed address and its ancestors to the lottery.
+     *
+     * A few ambassadors invite most of the network and the rest of the
+     * referrals hang off random earlier ones, within the depth and fan-out
+     * limits. Debits never exceed what an address was credited, so no ANV
+     * goes negative however many blocks are connected. The same seed always
+     * produces the same tree and blocks.
+     *
+     * The referral DB globals point at the simulation while it exists.
+     */
+    class LotterySim
+    {
+    public:
+        explicit LotterySim(const LotterySimOptions& options);
+        ~LotterySim();
+
+        /** Makes the debits and credits of the next block. */
+        DebitsAndCredits NextBlock();
+
+        /** Connects a block made by NextBlock, returns false on a DB error. */
+        bool ConnectBlock(const DebitsAndCredits& debits_and_credits, LotteryBlockStats& stats);
+
+        size_t TreeSize() const { return m_addresses.size(); }
+        const referral::ReferralsViewDB& DB() const { return *m_db; }
+
+    private:
+        LotterySimOptions m_options;
+        FastRandomContext m_rng;
+        fs::path m_path;
+        std::unique_ptr<referral::ReferralsViewDB> m_db;
+        std::unique_ptr<referral::ReferralsViewCache> m_cache;
+        referral::Addresses m_addresses;
+        std::vector<CAmount> m_balances;
+        int m_height;
+        uint256 m_prev_hash;
+
+        void BuildTree();
+    };
+}
+
+#endif // MERIT_BENCH_LOTTERY_SIM_H
@@ -0,0 +1,108 @@
+// Copyright (c) 2017-2018 The Merit Foundation developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+#include "bench/referral_util.h"
+#include "chainparams.h"
+#include "fs.h"
+#include "primitives/block.h"
+#include "random.h"
+#include "refdb.h"
+#include "referrals.h"
+#include "util.h"
+#include "utiltime.h"
+#include "validation.h"
+
+#include <memory>
+
+namespace
+{
+    const size_t CONFIRMED_ALIASES = 2000;
+    const size_t BLOCK_BEACONS = 4000;
+    const size_t ALIAS_LENGTH = 12;
+
+    std::string RandomAlias()
+    {
+        std::string alias(ALIAS_LENGTH, 'a');
+        for (auto& c : alias) {
+            c = 'a' + GetRand(26);
+        }
+        return alias;
+    }
+
+    referral::Referral RandomReferral(FastRandomContext& rng, const referral::Address& parent, const std::string& alias)
+    {
+        referral::Address address;
+        GetRandBytes(address.begin(), address.size());
+
+        return benchmark::MakeReferral(rng, address, parent, alias, referral::Referral::INVITE_VERSION);
+    }
+
+    /**
+     * An in-memory referral DB holding confirmed aliased referrals, and a
+     * block beaconing thousands of new ones with distinct aliases, as the
+     * referral cache sees them when the block connects.
+     */
+    struct AliasBenchSetup
+    {
+        fs::path path;
+        std::unique_ptr<referral::ReferralsViewDB> db;
+        std::unique_ptr<referral::ReferralsViewCache> cache;
+        CBlock block;
+
+        AliasBenchSetup()
+        {
+            SelectParams(CBaseChainParams::MAIN);
+            ClearDatadirCache();
+            path = fs::temp_directory_path() / strprintf("bench_merit_%lu_%i", (unsigned long)GetTime(), (int)GetRand(100000));
+            fs::create_directories(path);
+            gArgs.ForceSetArg("-datadir", path.string());
+
+            db.reset(new referral::ReferralsViewDB{0, true, true, "benchreferrals"});
+            cache.reset(new referral::ReferralsViewCache{db.get()});
+
+            FastRandomContext rng;
+            const auto root = RandomReferral(rng, referral::Address{}, "");
+            db->InsertReferral(root, true, false);
+
+            for (size_t i = 0; i < CONFIRMED_ALIASES; i++) {
+                const auto ref = RandomReferral(rng, root.GetAddress(), RandomAlias());
+                CAmount confirmations;
+                db->InsertReferral(ref, false, true);
+                db->UpdateConfirmation(ref.addressType, ref.GetAddress(), 1, confirmations);
+            }
+
+            for (size_t i = 0; i < BLOCK_BEACONS; i++) {
+                block.m_vRef.push_back(referral::MakeReferralRef(RandomReferral(rng, root.GetAddress(), RandomAlias())));
+            }
+
+            prefviewcache = cache.get();
+        }
+
+        ~AliasBenchSetup()
+        {
+            prefviewcache = nullptr;
+            cache.reset();
+            db.reset();
+            ClearDatadirCache();
+            fs::remove_all(path);
+        }
+    };
+}
+
+// Checks every beacon's alias against the block and the referral cache,
+// the way ConnectBlock does.
+static void ReferralAliasUnique(benchmark::State& state)
+{
+    AliasBenchSetup setup;
+    while (state.KeepRunning()) {
+        const auto aliases = IndexBlockAliases(setup.block, true);
+        for (const auto& ref : setup.block.m_vRef) {
+            const bool unique = CheckReferralAliasUnique(ref, &aliases, true);
+            assert(unique);
+        }
+    }
+}
+
+BENCHMARK(ReferralAliasUnique);
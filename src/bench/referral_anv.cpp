@@ -0,0 +1,129 @@
+// Copyright (c) 2017-2018 The Merit Foundation developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+#include "bench/referral_util.h"
+#include "chainparams.h"
+#include "fs.h"
+#include "random.h"
+#include "refdb.h"
+#include "util.h"
+#include "utiltime.h"
+
+#include <memory>
+#include <vector>
+
+namespace
+{
+    const size_t TREE_SIZE = 20000;
+    const size_t POPULAR_AMBASSADORS = 50;
+    const size_t MAX_DEPTH = 20;
+    const size_t BLOCKS = 16;
+    const size_t CHANGES_PER_BLOCK = 2000;
+
+    /**
+     * An in-memory referral DB holding a tree shaped roughly like mainnet,
+     * where a few ambassadors invite most of the network and the rest hang
+     * off random earlier referrals, along with blocks worth of debits and
+     * credits. Every block is followed by its inverse, like a connect and a
+     * disconnect, so ANVs stay bounded however long the bench runs.
+     */
+    struct ANVBenchSetup
+    {
+        fs::path path;
+        std::unique_ptr<referral::ReferralsViewDB> db;
+        referral::Addresses addresses;
+        std::vector<referral::ANVChanges> blocks;
+
+        ANVBenchSetup()
+        {
+            SelectParams(CBaseChainParams::MAIN);
+            ClearDatadirCache();
+            path = fs::temp_directory_path() / strprintf("bench_merit_%lu_%i", (unsigned long)GetTime(), (int)GetRand(100000));
+            fs::create_directories(path);
+            gArgs.ForceSetArg("-datadir", path.string());
+
+            db.reset(new referral::ReferralsViewDB{0, true, true, "benchreferrals"});
+
+            FastRandomContext rng;
+            std::vector<size_t> depths;
+            for (size_t i = 0; i < TREE_SIZE; i++) {
+                referral::Address address;
+                GetRandBytes(address.begin(), address.size());
+
+                referral::Address parent;
+                size_t depth = 0;
+                if (i > 0) {
+                    size_t parent_idx;
+                    do {
+                        parent_idx = GetRand(2) == 0 ?
+                            GetRand(std::min(i, POPULAR_AMBASSADORS)) :
+                            GetRand(i);
+                    } while (depths[parent_idx] >= MAX_DEPTH);
+
+                    parent = addresses[parent_idx];
+                    depth = depths[parent_idx] + 1;
+                }
+
+                db->InsertReferral(benchmark::MakeReferral(rng, address, parent), i == 0, false);
+
+                addresses.push_back(address);
+                depths.push_back(depth);
+            }
+
+            for (size_t b = 0; b < BLOCKS; b++) {
+                referral::ANVChanges changes;
+                for (size_t c = 0; c < CHANGES_PER_BLOCK; c++) {
+                    const auto& address = addresses[GetRand(addresses.size())];
+                    const CAmount amount = GetRand(1000000) + 1;
+                    changes.emplace_back(1, address, GetRand(4) == 0 ? -amount : amount);
+                }
+
+                referral::ANVChanges undo;
+                for (auto it = changes.rbegin(); it != changes.rend(); ++it) {
+                    undo.emplace_back(std::get<0>(*it), std::get<1>(*it), -std::get<2>(*it));
+                }
+
+                blocks.push_back(std::move(changes));
+                blocks.push_back(std::move(undo));
+            }
+        }
+
+        ~ANVBenchSetup()
+        {
+            db.reset();
+            ClearDatadirCache();
+            fs::remove_all(path);
+        }
+    };
+}
+
+// Applies each debit and credit with its own walk up the referral tree.
+static void ReferralANVUpdatePerChange(benchmark::State& state)
+{
+    ANVBenchSetup setup;
+    size_t block = 0;
+    while (state.KeepRunning()) {
+        for (const auto& change : setup.blocks[block]) {
+            const bool updated = setup.db->UpdateANV(std::get<0>(change), std::get<1>(change), std::get<2>(change));
+            assert(updated);
+        }
+        block = (block + 1) % setup.blocks.size();
+    }
+}
+
+// Applies a whole block of debits and credits in one pass up the tree.
+static void ReferralANVUpdatePerBlock(benchmark::State& state)
+{
+    ANVBenchSetup setup;
+    size_t block = 0;
+    while (state.KeepRunning()) {
+        const bool updated = setup.db->UpdateANVs(setup.blocks[block]);
+        assert(updated);
+        block = (block + 1) % setup.blocks.size();
+    }
+}
+
+BENCHMARK(ReferralANVUpdatePerChange);
+BENCHMARK(ReferralANVUpdatePerBlock);
@@ -0,0 +1,113 @@
+// Copyright (c) 2017-2018 The Merit Foundation developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+#include "bench/lottery_sim.h"
+#include "chainparams.h"
+#include "hash.h"
+#include "pog/select.h"
+#include "validation.h"
+
+namespace
+{
+    // Enough blocks to fill the reservoir before timing.
+    const size_t WARMUP_BLOCKS = 10;
+
+    void WarmUp(benchmark::LotterySim& sim)
+    {
+        benchmark::LotteryBlockStats stats;
+        for (size_t b = 0; b < WARMUP_BLOCKS; b++) {
+            const bool connected = sim.ConnectBlock(sim.NextBlock(), stats);
+            assert(connected);
+        }
+    }
+}
+
+// Connects a block to the referral DB the way ConnectBlock does: rewards the
+// ambassadors, updates the ANVs, offers the changed addresses to the lottery
+// and flushes. Making the block is part of the timing but cheap in comparison.
+static void ReferralLotteryConnectBlock(benchmark::State& state)
+{
+    benchmark::LotterySim sim{benchmark::LotterySimOptions{}};
+    WarmUp(sim);
+
+    benchmark::LotteryBlockStats stats;
+    while (state.KeepRunning()) {
+        const bool connected = sim.ConnectBlock(sim.NextBlock(), stats);
+        assert(connected);
+    }
+}
+
+// Picks the ambassadors to reward from a full reservoir.
+static void ReferralLotteryRewardAmbassadors(benchmark::State& state)
+{
+    benchmark::LotterySim sim{benchmark::LotterySimOptions{}};
+    WarmUp(sim);
+
+    const auto& params = Params().GetConsensus();
+    const int height = benchmark::LotterySimOptions{}.start_height + WARMUP_BLOCKS;
+    const auto ambassador_subsidy = GetSplitSubsidy(height, params).ambassador;
+
+    uint256 hash;
+    while (state.KeepRunning()) {
+        hash = Hash(hash.begin(), hash.end());
+        const auto lottery = RewardAmbassadors(height, hash, ambassador_subsidy, params);
+        assert(!lottery.winners.empty());
+    }
+}
+
+// Picks winners the way blocks before the ANV tree did: list the entrants,
+// sort them into a distribution and sample it.
+static void ReferralLotterySelectSorted(benchmark::State& state)
+{
+    benchmark::LotterySim sim{benchmark::LotterySimOptions{}};
+    WarmUp(sim);
+
+    const auto& params = Params().GetConsensus();
+    const int height = benchmark::LotterySimOptions{}.start_height + WARMUP_BLOCKS;
+
+    uint256 hash;
+    while (state.KeepRunning()) {
+        referral::AddressANVs entrants;
+        sim.DB().GetAllRewardableANVs(params, height, entrants);
+
+        const pog::WalletSelector selector{height, entrants};
+        hash = Hash(hash.begin(), hash.end());
+        const auto winners = selector.Select(
+                false,
+                *prefviewcache,
+                hash,
+                std::min(params.total_winning_ambassadors, static_cast<uint64_t>(selector.Size())));
+        assert(!winners.empty());
+    }
+}
+
+// Picks the same winners straight from the ANV tree.
+static void ReferralLotterySelectTree(benchmark::State& state)
+{
+    benchmark::LotterySim sim{benchmark::LotterySimOptions{}};
+    WarmUp(sim);
+
+    const auto& params = Params().GetConsensus();
+
+    uint256 hash;
+    while (state.KeepRunning()) {
+        const auto* tree = sim.DB().GetRewardableANVTree(params.genesis_address);
+        assert(tree);
+
+        const pog::WalletSelector selector{*tree};
+        hash = Hash(hash.begin(), hash.end());
+        const auto winners = selector.Select(
+                false,
+                *prefviewcache,
+                hash,
+                std::min(params.total_winning_ambassadors, static_cast<uint64_t>(selector.Size())));
+        assert(!winners.empty());
+    }
+}
+
+BENCHMARK(ReferralLotteryConnectBlock);
+BENCHMARK(ReferralLotteryRewardAmbassadors);
+BENCHMARK(ReferralLotterySelectSorted);
+BENCHMARK(ReferralLotterySelectTree);
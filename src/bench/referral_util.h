@@ -0,0 +1,40 @@
+// Copyright (c) 2017-2018 The Merit Foundation developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef MERIT_BENCH_REFERRAL_UTIL_H
+#define MERIT_BENCH_REFERRAL_UTIL_H
+
+#include "primitives/referral.h"
+#include "pubkey.h"
+#include "random.h"
+
+#include <string>
+
+namespace benchmark
+{
+    /**
+     * A key id referral for the benches. Its pubkey is a well formed
+     * compressed key of random bytes, it is never checked.
+     */
+    inline referral::Referral MakeReferral(
+            FastRandomContext& rng,
+            const referral::Address& address,
+            const referral::Address& parent,
+            const std::string& alias = "",
+            int32_t version = referral::Referral::CURRENT_VERSION)
+    {
+        auto pubkey = rng.randbytes(33);
+        pubkey[0] = 0x02;
+
+        return referral::MutableReferral{
+            1,
+            address,
+            CPubKey{pubkey.begin(), pubkey.end()},
+            parent,
+            alias,
+            version};
+    }
+}
+
+#endif // MERIT_BENCH_REFERRAL_UTIL_H
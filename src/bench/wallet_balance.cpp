@@ -0,0 +1,87 @@
+// Copyright (c) 2017-2018 The Merit Foundation developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+#include "chain.h"
+#include "key.h"
+#include "script/standard.h"
+#include "validation.h"
+#include "wallet/wallet.h"
+
+namespace
+{
+    const size_t WALLET_TXS = 100000;
+
+    /**
+     * A wallet holding many confirmed payments to one of its keys, all
+     * in a block at the tip of the active chain.
+     */
+    struct BalanceBenchSetup
+    {
+        CWallet wallet;
+        CBlockIndex tip;
+        uint256 tip_hash;
+
+        BalanceBenchSetup()
+        {
+            CKey key;
+            key.MakeNewKey(true);
+            const CPubKey pubkey = key.GetPubKey();
+            wallet.CCryptoKeyStore::AddKeyPubKey(key, pubkey);
+            const CScript script = GetScriptForDestination(pubkey.GetID());
+
+            LOCK2(cs_main, wallet.cs_wallet);
+
+            tip_hash = GetRandHash();
+            tip.phashBlock = &tip_hash;
+            mapBlockIndex[tip_hash] = &tip;
+            chainActive.SetTip(&tip);
+
+            for (size_t i = 0; i < WALLET_TXS; i++) {
+                CMutableTransaction tx;
+                tx.nLockTime = i; // so all transactions get different hashes
+                tx.vout.emplace_back(COIN, script);
+
+                CWalletTx wtx(&wallet, MakeTransactionRef(std::move(tx)));
+                wtx.hashBlock = tip_hash;
+                wtx.nIndex = i;
+                wallet.LoadToWallet(wtx);
+            }
+        }
+
+        ~BalanceBenchSetup()
+        {
+            LOCK(cs_main);
+            chainActive.SetTip(nullptr);
+            mapBlockIndex.erase(tip_hash);
+        }
+    };
+}
+
+// A full scan of the wallet, which every balance query used to do.
+static void WalletBalanceScan(benchmark::State& state)
+{
+    BalanceBenchSetup setup;
+    LOCK2(cs_main, setup.wallet.cs_wallet);
+    while (state.KeepRunning()) {
+        const auto balances = setup.wallet.TallyBalances();
+        assert(balances.coins.available == static_cast<CAmount>(WALLET_TXS) * COIN);
+    }
+}
+
+// Polling the balances of an unchanged wallet, as getbalance and getinfo do.
+static void WalletBalanceCached(benchmark::State& state)
+{
+    BalanceBenchSetup setup;
+    while (state.KeepRunning()) {
+        const CAmount balance = setup.wallet.GetBalance();
+        assert(balance == static_cast<CAmount>(WALLET_TXS) * COIN);
+        setup.wallet.GetUnconfirmedBalance();
+        setup.wallet.GetImmatureBalance();
+        setup.wallet.GetRewards();
+    }
+}
+
+BENCHMARK(WalletBalanceScan);
+BENCHMARK(WalletBalanceCached);
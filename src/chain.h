@@ -215,7 +215,7 @@ public:
     unsigned int nNonce;
     uint8_t nEdgeBits;
 
-    std::set<uint32_t> sCycle;
+    cuckoo::Cycle sCycle;
 
     //! (memory only) Sequential id assigned to distinguish order in which blocks are received.
     int32_t nSequenceId;
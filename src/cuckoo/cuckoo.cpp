@@ -7,6 +7,7 @@
 
 #include "cuckoo.h"
 #include "consensus/consensus.h"
+#include "crypto/siphashxN.h"
 #include "util.h"
 
 #include <stdint.h> // for types uint32_t,uint64_t
@@ -30,6 +31,58 @@ uint64_t siphash24(const siphash_keys* keys, const uint64_t nonce)
 }
 
 
+void siphash24xN(
+        const uint64_t* k0s,
+        const uint64_t* k1s,
+        const uint64_t* nonces,
+        uint64_t* hashes,
+        size_t n)
+{
+    size_t i = 0;
+
+#if NSIPHASH == 8
+    const __m256i c0 = _mm256_set1_epi64x(0x736f6d6570736575ULL);
+    const __m256i c1 = _mm256_set1_epi64x(0x646f72616e646f6dULL);
+    const __m256i c2 = _mm256_set1_epi64x(0x6c7967656e657261ULL);
+    const __m256i c3 = _mm256_set1_epi64x(0x7465646279746573ULL);
+    const __m256i ff = _mm256_set1_epi64x(0xff);
+
+    // two vectors of four lanes, every lane with its own keys
+    for (; i + 8 <= n; i += 8) {
+        const __m256i k0a = _mm256_loadu_si256((const __m256i*)(k0s + i));
+        const __m256i k0b = _mm256_loadu_si256((const __m256i*)(k0s + i + 4));
+        const __m256i k1a = _mm256_loadu_si256((const __m256i*)(k1s + i));
+        const __m256i k1b = _mm256_loadu_si256((const __m256i*)(k1s + i + 4));
+        const __m256i na = _mm256_loadu_si256((const __m256i*)(nonces + i));
+        const __m256i nb = _mm256_loadu_si256((const __m256i*)(nonces + i + 4));
+
+        __m256i v0 = XOR(k0a, c0), v4 = XOR(k0b, c0);
+        __m256i v1 = XOR(k1a, c1), v5 = XOR(k1b, c1);
+        __m256i v2 = XOR(k0a, c2), v6 = XOR(k0b, c2);
+        __m256i v3 = XOR(XOR(k1a, c3), na), v7 = XOR(XOR(k1b, c3), nb);
+
+        SIPROUNDX8;
+        SIPROUNDX8;
+        v0 = XOR(v0, na);
+        v4 = XOR(v4, nb);
+        v2 = XOR(v2, ff);
+        v6 = XOR(v6, ff);
+        SIPROUNDX8;
+        SIPROUNDX8;
+        SIPROUNDX8;
+        SIPROUNDX8;
+
+        _mm256_storeu_si256((__m256i*)(hashes + i), XOR(XOR(v0, v1), XOR(v2, v3)));
+        _mm256_storeu_si256((__m256i*)(hashes + i + 4), XOR(XOR(v4, v5), XOR(v6, v7)));
+    }
+#endif
+
+    for (; i < n; i++) {
+        const siphash_keys keys{k0s[i], k1s[i]};
+        hashes[i] = siphash24(&keys, nonces[i]);
+    }
+}
+
 // convenience function for extracting siphash keys from header
 void setKeys(const char* header, const uint32_t headerlen, siphash_keys* keys)
 {
@@ -41,6 +94,20 @@ void setKeys(const char* header, const uint32_t headerlen, siphash_keys* keys)
     keys->k1 = htole64(((uint64_t*)hdrkey)[1]);
 }
 
+void setKeys(const uint256& hash, siphash_keys* keys)
+{
+    // same characters as hash.GetHex(), without building a string
+    static const char digits[] = "0123456789abcdef";
+    char hex[2 * 32];
+    for (size_t i = 0; i < 32; i++) {
+        const uint8_t c = hash.begin()[31 - i];
+        hex[2 * i] = digits[c >> 4];
+        hex[2 * i + 1] = digits[c & 0xf];
+    }
+
+    setKeys(hex, sizeof(hex), keys);
+}
+
 // generate edge endpoint in cuckoo graph without partition bit
 uint32_t _sipnode(const siphash_keys* keys, uint32_t mask, uint32_t nonce, uint32_t uorv)
 {
@@ -124,10 +191,11 @@ int path(uint32_t* cuckoo, uint32_t u, uint32_t* us)
 
 typedef std::pair<uint32_t, uint32_t> edge;
 
-void solution(CuckooCtx* ctx, uint32_t* us, int nu, uint32_t* vs, int nv, std::set<uint32_t>& nonces, const uint32_t edgeMask)
+void solution(CuckooCtx* ctx, uint32_t* us, int nu, uint32_t* vs, int nv, cuckoo::Cycle& nonces, const uint32_t edgeMask)
 {
     assert(nonces.empty());
     std::set<edge> cycle;
+    std::vector<uint32_t> found;
 
     unsigned n;
     cycle.insert(edge(*us, *vs));
@@ -143,13 +211,14 @@ void solution(CuckooCtx* ctx, uint32_t* us, int nu, uint32_t* vs, int nv, std::s
         if (cycle.find(e) != cycle.end()) {
             // LogPrintf("%x ", nonce);
             cycle.erase(e);
-            nonces.insert(nonce);
+            found.push_back(nonce);
         }
     }
     // LogPrintf("\n");
+    nonces = cuckoo::Cycle{found.begin(), found.end()};
 }
 
-bool FindCycle(const uint256& hash, uint8_t edgeBits, uint8_t proofSize, std::set<uint32_t>& cycle)
+bool FindCycle(const uint256& hash, uint8_t edgeBits, uint8_t proofSize, cuckoo::Cycle& cycle)
 {
     assert(edgeBits >= MIN_EDGE_BITS && edgeBits <= MAX_EDGE_BITS);
 
@@ -220,7 +289,7 @@ bool FindCycle(const uint256& hash, uint8_t edgeBits, uint8_t proofSize, std::se
 
 // check it easiness makes any sence here
 // verify that nonces are ascending and form a cycle in header-generated graph
-int VerifyCycle(const uint256& hash, uint8_t edgeBits, uint8_t proofSize, const std::vector<uint32_t>& cycle)
+int VerifyCycle(const uint256& hash, uint8_t edgeBits, uint8_t proofSize, const cuckoo::Cycle& cycle)
 {
     assert(cycle.size() == proofSize);
     assert(edgeBits >= MIN_EDGE_BITS && edgeBits <= MAX_EDGE_BITS);
@@ -229,12 +298,9 @@ int VerifyCycle(const uint256& hash, uint8_t edgeBits, uint8_t proofSize, const
     // edge mask is a max valid value of an edge (max index of nodes array).
     uint32_t edgeMask = (1 << edgeBits) - 1;
 
-    auto hashStr = hash.GetHex();
-
-    setKeys(hashStr.c_str(), hashStr.size(), &keys);
+    setKeys(hash, &keys);
 
     std::vector<uint32_t> uvs(2 * proofSize);
-    uint32_t xor0 = 0, xor1 = 0;
 
     for (uint32_t n = 0; n < proofSize; n++) {
         if (cycle[n] > edgeMask) {
@@ -245,8 +311,19 @@ int VerifyCycle(const uint256& hash, uint8_t edgeBits, uint8_t proofSize, const
             return POW_TOO_SMALL;
         }
 
-        xor0 ^= uvs[2 * n] = sipnode(&keys, edgeMask, cycle[n], 0);
-        xor1 ^= uvs[2 * n + 1] = sipnode(&keys, edgeMask, cycle[n], 1);
+        uvs[2 * n] = sipnode(&keys, edgeMask, cycle[n], 0);
+        uvs[2 * n + 1] = sipnode(&keys, edgeMask, cycle[n], 1);
+    }
+
+    return VerifyCycleNodes(uvs.data(), proofSize);
+}
+
+int VerifyCycleNodes(const uint32_t* uvs, uint8_t proofSize)
+{
+    uint32_t xor0 = 0, xor1 = 0;
+    for (uint32_t n = 0; n < proofSize; n++) {
+        xor0 ^= uvs[2 * n];
+        xor1 ^= uvs[2 * n + 1];
     }
 
     // matching endpoints imply zero xors
@@ -254,9 +331,11 @@ int VerifyCycle(const uint256& hash, uint8_t edgeBits, uint8_t proofSize, const
         return POW_NON_MATCHING;
     }
 
+    // k wraps around without a division, which took most of the time
+    const uint32_t nodes = 2 * proofSize;
     uint32_t n = 0, i = 0, j;
     do { // follow cycle
-        for (uint32_t k = j = i; (k = (k + 2) % (2 * proofSize)) != i;) {
+        for (uint32_t k = j = i; (k = k + 2 < nodes ? k + 2 : k + 2 - nodes) != i;) {
             if (uvs[k] == uvs[i]) { // find other edge endpoint identical to one at i
                 if (j != i) {       // already found one before
                     return POW_BRANCH;
@@ -6,6 +6,7 @@
 #define MERIT_CUCKOO_CUCKOO_H
 
 #include "crypto/blake2/blake2.h"
+#include "cuckoo/cycle.h"
 #include "hash.h"
 #include "uint256.h"
 
@@ -46,9 +47,21 @@ typedef struct {
 // SipHash-2-4 specialized to precomputed key and 8 byte nonces
 uint64_t siphash24(const siphash_keys* keys, const uint64_t nonce);
 
+// SipHash-2-4 of n nonces, each one with its own keys, several at a time
+// with AVX2
+void siphash24xN(
+        const uint64_t* k0s,
+        const uint64_t* k1s,
+        const uint64_t* nonces,
+        uint64_t* hashes,
+        size_t n);
+
 // convenience function for extracting siphash keys from header
 void setKeys(const char* header, const uint32_t headerlen, siphash_keys* keys);
 
+// siphash keys of the graph generated by block hash
+void setKeys(const uint256& hash, siphash_keys* keys);
+
 // generate edge endpoint in cuckoo graph without partition bit
 uint32_t _sipnode(const siphash_keys* keys, uint32_t mask, uint32_t nonce, uint32_t uorv);
 
@@ -61,10 +74,14 @@ uint32_t sipnode(const CSipHasher* hasher, uint32_t mask, uint32_t nonce, uint32
 uint32_t sipnode(const siphash_keys* keys, uint32_t mask, uint32_t nonce, uint32_t uorv);
 
 // Find proofsize-length cuckoo cycle in random graph
-bool FindCycle(const uint256& hash, uint8_t edgeBits, uint8_t proofSize, std::set<uint32_t>& cycle);
+bool FindCycle(const uint256& hash, uint8_t edgeBits, uint8_t proofSize, cuckoo::Cycle& cycle);
 
 // verify that cycle is valid in block hash generated graph
-int VerifyCycle(const uint256& hash, uint8_t edgeBits, uint8_t proofSize, const std::vector<uint32_t>& cycle);
+int VerifyCycle(const uint256& hash, uint8_t edgeBits, uint8_t proofSize, const cuckoo::Cycle& cycle);
+
+// verify that the 2 * proofSize endpoints of the cycle edges, u and v
+// of every edge in turn, form a single cycle
+int VerifyCycleNodes(const uint32_t* uvs, uint8_t proofSize);
 
 
 #endif // MERIT_CUCKOO_CUCKOO_H
@@ -0,0 +1,108 @@
+// Copyright (c) 2017-2018 The Merit Foundation developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef MERIT_CUCKOO_CYCLE_H
+#define MERIT_CUCKOO_CYCLE_H
+
+#include "prevector.h"
+#include "serialize.h"
+
+#include <algorithm>
+#include <initializer_list>
+#include <stdint.h>
+
+namespace cuckoo
+{
+
+/** Number of cycle nonces stored inline, the proof size of every network. */
+static const unsigned int CYCLE_INLINE_SIZE = 42;
+
+/**
+ * Nonces of the edges of a cuckoo cycle, ascending and without duplicates.
+ *
+ * The nonces are stored inline, so a cycle of up to CYCLE_INLINE_SIZE nonces
+ * takes no heap allocation, unlike the std::set it replaces which took one
+ * per nonce. It serializes exactly as that std::set did: a compact size
+ * followed by the nonces in ascending order. Nonces read out of order or
+ * more than once are sorted and deduplicated, as inserting them into the
+ * set did, so the hash of a cycle does not depend on how it was sent.
+ */
+class Cycle
+{
+public:
+    typedef prevector<CYCLE_INLINE_SIZE, uint32_t> nonces_type;
+    typedef nonces_type::size_type size_type;
+    typedef nonces_type::value_type value_type;
+    typedef nonces_type::const_iterator const_iterator;
+
+    Cycle() {}
+
+    Cycle(std::initializer_list<uint32_t> nonces) : m_nonces{nonces.begin(), nonces.end()}
+    {
+        Normalize();
+    }
+
+    template <typename InputIterator>
+    Cycle(InputIterator first, InputIterator last)
+    {
+        for (; first != last; ++first) {
+            m_nonces.push_back(*first);
+        }
+        Normalize();
+    }
+
+    size_type size() const { return m_nonces.size(); }
+    bool empty() const { return m_nonces.empty(); }
+    void clear() { m_nonces.clear(); }
+
+    const_iterator begin() const { return m_nonces.begin(); }
+    const_iterator end() const { return m_nonces.end(); }
+
+    const uint32_t* data() const { return m_nonces.data(); }
+    const uint32_t& operator[](size_type pos) const { return m_nonces[pos]; }
+    const uint32_t& front() const { return m_nonces.front(); }
+    const uint32_t& back() const { return m_nonces.back(); }
+
+    friend bool operator==(const Cycle& a, const Cycle& b) { return a.m_nonces == b.m_nonces; }
+    friend bool operator!=(const Cycle& a, const Cycle& b) { return !(a == b); }
+
+    template <typename Stream>
+    void Serialize(Stream& s) const
+    {
+        WriteCompactSize(s, m_nonces.size());
+        for (const auto nonce : m_nonces) {
+            ::Serialize(s, nonce);
+        }
+    }
+
+    template <typename Stream>
+    void Unserialize(Stream& s)
+    {
+        m_nonces.clear();
+
+        // nonces are read one at a time so a bogus size can not make us
+        // allocate more than the stream holds
+        const auto size = ReadCompactSize(s);
+        for (uint64_t i = 0; i < size; i++) {
+            uint32_t nonce;
+            ::Unserialize(s, nonce);
+            m_nonces.push_back(nonce);
+        }
+
+        Normalize();
+    }
+
+private:
+    nonces_type m_nonces;
+
+    void Normalize()
+    {
+        std::sort(m_nonces.begin(), m_nonces.end());
+        m_nonces.erase(std::unique(m_nonces.begin(), m_nonces.end()), m_nonces.end());
+    }
+};
+
+}
+
+#endif // MERIT_CUCKOO_CYCLE_H
@@ -4,13 +4,13 @@
 
 #include "mean_cuckoo.h"
 #include "cuckoo.h"
+#include "solver_team.h"
 
 #include "consensus/consensus.h"
 #include "crypto/siphashxN.h"
 #include "tinyformat.h"
+#include "utiltime.h"
 #include <bitset>
-#include <condition_variable>
-#include <mutex>
 #include <pthread.h>
 #include <string.h>
 #include <sys/time.h>
@@ -18,6 +18,16 @@
 #include <unistd.h>
 #include <x86intrin.h>
 
+#ifndef WIN32
+#include <sys/mman.h>
+#endif
+
+// Some systems (at least OS X) do not define MAP_ANONYMOUS yet and define
+// MAP_ANON which is deprecated
+#if !defined(WIN32) && !defined(MAP_ANONYMOUS)
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+
 // algorithm/performance parameters
 
 // The node bits are logically split into 3 groups:
@@ -72,34 +82,71 @@
 #define TRIMFRAC256 184
 #endif
 
-class Barrier
+// Owns all the buffers of a solver. With huge pages enabled the buffers are
+// backed by anonymous mappings, explicit huge pages first and transparent
+// huge pages as a fallback, which cuts TLB misses during bucket sorting.
+class SolverAllocator
 {
 public:
-    explicit Barrier(std::size_t nThreadsIn) : nThreads(nThreadsIn),
-                                               nCount(nThreadsIn),
-                                               nGeneration(0)
+    explicit SolverAllocator(bool hugePagesIn) : hugePages{hugePagesIn} {}
+
+    ~SolverAllocator()
     {
+        for (const auto& chunk : chunks) {
+#ifndef WIN32
+            if (chunk.second > 0) {
+                munmap(chunk.first, chunk.second);
+                continue;
+            }
+#endif
+            ::operator delete(chunk.first);
+        }
     }
 
-    void Wait()
+    SolverAllocator(const SolverAllocator&) = delete;
+    SolverAllocator& operator=(const SolverAllocator&) = delete;
+
+    template <typename T>
+    T* Allocate(size_t n)
     {
-        std::unique_lock<std::mutex> lLock{mMutex};
-        auto lGen = nGeneration;
-        if (!--nCount) {
-            nGeneration++;
-            nCount = nThreads;
-            cv.notify_all();
-        } else {
-            cv.wait(lLock, [this, lGen] { return lGen != nGeneration; });
-        }
+        return static_cast<T*>(AllocateBytes(n * sizeof(T)));
     }
 
+    uint64_t Allocated() const { return allocated; }
+
 private:
-    std::mutex mMutex;
-    std::condition_variable cv;
-    std::size_t nThreads;
-    std::size_t nCount;
-    std::size_t nGeneration;
+    void* AllocateBytes(size_t size)
+    {
+        allocated += size;
+#ifndef WIN32
+        if (hugePages) {
+            void* addr = MAP_FAILED;
+#ifdef MAP_HUGETLB
+            addr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+#endif
+            if (addr == MAP_FAILED) {
+                addr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+#ifdef MADV_HUGEPAGE
+                if (addr != MAP_FAILED) {
+                    madvise(addr, size, MADV_HUGEPAGE);
+                }
+#endif
+            }
+            if (addr != MAP_FAILED) {
+                chunks.emplace_back(addr, size);
+                return addr;
+            }
+        }
+#endif
+        void* addr = ::operator new(size);
+        chunks.emplace_back(addr, 0);
+        return addr;
+    }
+
+    bool hugePages;
+    uint64_t allocated = 0;
+    // allocated chunks along with mapping length, 0 for heap allocations
+    std::vector<std::pair<void*, size_t>> chunks;
 };
 
 template <uint8_t EDGEBITS, uint8_t XBITS>
@@ -301,9 +348,14 @@ public:
     zbucket8P* tdegs;
     offset_t* tcounts;
     uint8_t nThreads;
-    ctpl::thread_pool& pool;
     uint32_t nTrims;
-    Barrier* barry;
+    cuckoo::SpinBarrier barry;
+    cuckoo::SolverTeam team;
+    SolverAllocator alloc;
+
+    // time spent in every round, measured by the first thread of the team
+    std::vector<int64_t> roundMicros;
+    int64_t roundStart = 0;
 
     using BIGTYPE0 = offset_t;
 
@@ -314,37 +366,43 @@ public:
     }
 
     edgetrimmer(
-            ctpl::thread_pool& poolIn,
             size_t nThreadsIn,
-            const uint32_t nTrimsIn) : pool{poolIn}, nTrims{nTrimsIn}
+            const uint32_t nTrimsIn,
+            bool hugePages) : nThreads(nThreadsIn),
+                              nTrims{nTrimsIn},
+                              barry{nThreadsIn, cuckoo::DefaultSpins(nThreadsIn)},
+                              team{nThreadsIn},
+                              alloc{hugePages},
+                              roundMicros(nTrimsIn, 0)
     {
         assert(sizeof(matrix<EDGEBITS, XBITS, P::ZBUCKETSIZE>) == P::NX * sizeof(yzbucketZ));
-        assert(sizeof(matrix<EDGEBITS, XBITS, P::ZBUCKETSIZE>) == P::NX * sizeof(yzbucketZ));
 
-        nThreads = nThreadsIn;
+        buckets = alloc.Allocate<yzbucketZ>(P::NX);
+        tbuckets = alloc.Allocate<yzbucketT>(nThreads);
+        tedges = alloc.Allocate<zbucket32P>(nThreads);
+        tdegs = alloc.Allocate<zbucket8P>(nThreads);
+        tzs = alloc.Allocate<zbucket16P>(nThreads);
+        tcounts = alloc.Allocate<offset_t>(nThreads);
 
-        buckets = new yzbucketZ[P::NX];
-        touch((uint8_t*)buckets, sizeof(matrix<EDGEBITS, XBITS, P::ZBUCKETSIZE>));
-        tbuckets = new yzbucketT[nThreads];
-        touch((uint8_t*)tbuckets, nThreads * sizeof(yzbucketT));
-
-        tedges = new zbucket32P[nThreads];
-        tdegs = new zbucket8P[nThreads];
-        tzs = new zbucket16P[nThreads];
-        tcounts = new offset_t[nThreads];
-
-        barry = new Barrier(nThreads);
+        // pages are placed on the NUMA node of the thread touching them
+        // first, so every team member touches the buffers it works on
+        team.Run([this](uint32_t id) { touchlocal(id); });
     }
-    ~edgetrimmer()
+
+    // the matrix columns a thread fills in the first round and its own buffers
+    void touchlocal(const uint32_t id)
     {
-        delete[] buckets;
-        delete[] tbuckets;
-        delete[] tedges;
-        delete[] tdegs;
-        delete[] tzs;
-        delete[] tcounts;
-        delete barry;
+        const uint32_t starty = P::NY * id / nThreads;
+        const uint32_t endy = P::NY * (id + 1) / nThreads;
+        for (uint32_t ux = 0; ux < P::NX; ux++)
+            touch((uint8_t*)&buckets[ux][starty], (endy - starty) * sizeof(zbucketZ));
+
+        touch((uint8_t*)&tbuckets[id], sizeof(yzbucketT));
+        touch((uint8_t*)&tedges[id], sizeof(zbucket32P));
+        touch((uint8_t*)&tdegs[id], sizeof(zbucket8P));
+        touch((uint8_t*)&tzs[id], sizeof(zbucket16P));
     }
+
     offset_t count() const
     {
         offset_t cnt = 0;
@@ -947,31 +1005,31 @@ public:
 
     void trim()
     {
-        if (nThreads == 1) {
-            trimmer(0);
-            return;
-        }
-
-        std::vector<std::future<void>> jobs;
-        for (int t = 0; t < nThreads; t++) {
-            jobs.push_back(
-                    pool.push([this, t](int id) {
-                        etworker<offset_t, EDGEBITS, XBITS>(this, t);
-                    }));
-        }
+        roundStart = GetTimeMicros();
+        team.Run([this](uint32_t id) {
+            etworker<offset_t, EDGEBITS, XBITS>(this, id);
+        });
+        roundMicros[nTrims - 1] += GetTimeMicros() - roundStart;
+    }
 
-        for(auto& j : jobs) {
-            j.wait();
+    // the barrier between a round and the next one
+    void endround(const uint32_t id, const uint32_t round)
+    {
+        barry.Wait();
+        if (id == 0) {
+            const int64_t now = GetTimeMicros();
+            roundMicros[round] += now - roundStart;
+            roundStart = now;
         }
     }
 
     void trimmer(uint32_t id)
     {
         genUnodes(id, 0);
-        barry->Wait();
+        endround(id, 0);
         genVnodes(id, 1);
         for (uint32_t round = 2; round < nTrims - 2; round += 2) {
-            barry->Wait();
+            endround(id, round - 1);
             if (round < P::COMPRESSROUND) {
                 if (round < P::EXPANDROUND)
                     trimedges<P::BIGSIZE, P::BIGSIZE, true>(id, round);
@@ -983,7 +1041,7 @@ public:
                 trimrename<P::BIGGERSIZE, P::BIGGERSIZE, true>(id, round);
             } else
                 trimedges1<true>(id, round);
-            barry->Wait();
+            endround(id, round);
             if (round < P::COMPRESSROUND) {
                 if (round + 1 < P::EXPANDROUND)
                     trimedges<P::BIGSIZE, P::BIGSIZE, false>(id, round + 1);
@@ -996,9 +1054,9 @@ public:
             } else
                 trimedges1<false>(id, round + 1);
         }
-        barry->Wait();
+        endround(id, nTrims - 3);
         trimrename1<true>(id, nTrims - 2);
-        barry->Wait();
+        endround(id, nTrims - 2);
         trimrename1<false>(id, nTrims - 1);
     }
 };
@@ -1025,26 +1083,21 @@ public:
     std::vector<uint32_t> cyclevs;
     std::bitset<P::NXY> uxymap;
     std::vector<uint32_t> sols; // concatanation of all proof's indices
-    ctpl::thread_pool& pool;
     size_t nThreads;
     uint8_t proofSize;
+    cuckoo::SolverStats stats;
 
     solver_ctx(
-            ctpl::thread_pool& poolIn,
             size_t nThreadsIn,
-            const char* header,
-            const uint32_t headerlen,
             const uint32_t nTrims,
-            const uint8_t proofSizeIn) : pool{poolIn}, nThreads{nThreadsIn}, proofSize{proofSizeIn}
+            const uint8_t proofSizeIn,
+            bool hugePages) : nThreads{nThreadsIn}, proofSize{proofSizeIn}
     {
-        trimmer = new edgetrimmer<offset_t, EDGEBITS, XBITS>(pool, nThreadsIn, nTrims);
+        trimmer = new edgetrimmer<offset_t, EDGEBITS, XBITS>(nThreadsIn, nTrims, hugePages);
 
-        cycleus.reserve(proofSize);
-        cyclevs.reserve(proofSize);
-
-        setKeys(header, headerlen, &trimmer->sip_keys);
-
-        cuckoo = 0;
+        cycleus.resize(proofSize);
+        cyclevs.resize(proofSize);
+        sols.reserve(proofSize);
     }
 
     ~solver_ctx()
@@ -1052,6 +1105,16 @@ public:
         delete trimmer;
     }
 
+    // Rekey the graph for the next header while keeping all the buffers
+    void reset(const char* header, const uint32_t headerlen)
+    {
+        setKeys(header, headerlen, &trimmer->sip_keys);
+
+        uxymap.reset();
+        sols.clear();
+        cuckoo = 0;
+    }
+
     uint64_t sharedbytes() const
     {
         return sizeof(matrix<EDGEBITS, XBITS, P::ZBUCKETSIZE>);
@@ -1097,18 +1160,9 @@ public:
 
         sols.resize(sols.size() + proofSize);
 
-        std::vector<std::future<void>> jobs;
-        for (size_t t = 0; t < nThreads; t++) {
-            jobs.push_back(
-                    pool.push(
-                        [this, t](int id) {
-                            matchworker<offset_t, EDGEBITS, XBITS>(this, t);
-                        }));
-        }
-
-        for (auto& j : jobs) {
-            j.wait();
-        }
+        trimmer->team.Run([this](uint32_t id) {
+            matchworker<offset_t, EDGEBITS, XBITS>(this, id);
+        });
 
         qsort(&sols[sols.size() - proofSize], proofSize, sizeof(uint32_t), nonce_cmp);
     }
@@ -1181,11 +1235,18 @@ public:
     bool solve()
     {
         assert((uint64_t)P::CUCKOO_SIZE * sizeof(uint32_t) <= trimmer->nThreads * sizeof(yzbucketT));
+        const int64_t nStart = GetTimeMicros();
         trimmer->trim();
+        const int64_t nTrimmed = GetTimeMicros();
+
         cuckoo = (uint32_t*)trimmer->tbuckets;
         memset(cuckoo, CUCKOO_NIL, P::CUCKOO_SIZE * sizeof(uint32_t));
+        const bool found = findcycles();
 
-        return findcycles();
+        stats.graphs++;
+        stats.trimMicros += nTrimmed - nStart;
+        stats.cycleMicros += GetTimeMicros() - nTrimmed;
+        return found;
     }
 
     void* matchUnodes(uint32_t threadId)
@@ -1287,67 +1348,105 @@ public:
 };
 
 template <typename offset_t, uint8_t EDGEBITS, uint8_t XBITS>
-bool run(const uint256& hash, uint8_t proofSize, std::set<uint32_t>& cycle, size_t nThreads, ctpl::thread_pool& pool)
+class MeanSolver : public cuckoo::Solver
 {
-    assert(EDGEBITS >= MIN_EDGE_BITS && EDGEBITS <= MAX_EDGE_BITS);
+public:
+    MeanSolver(
+            size_t nThreadsIn,
+            uint8_t proofSize,
+            bool hugePages) : nThreads{nThreadsIn},
+                              ctx{nThreadsIn, EDGEBITS >= 30 ? 96u : 68u, proofSize, hugePages}
+    {
+        static_assert(EDGEBITS >= MIN_EDGE_BITS && EDGEBITS <= MAX_EDGE_BITS, "unsupported edge bits");
+    }
 
-    uint32_t nTrims = EDGEBITS >= 30 ? 96 : 68;
+    bool Solve(const uint256& hash, cuckoo::Cycle& cycle) override
+    {
+        auto hashStr = hash.GetHex();
 
-    auto hashStr = hash.GetHex();
+        ctx.reset(hashStr.c_str(), hashStr.size());
 
-    solver_ctx<offset_t, EDGEBITS, XBITS> ctx(pool, nThreads, hashStr.c_str(), hashStr.size(), nTrims, proofSize);
+        bool found = ctx.solve();
 
-    bool found = ctx.solve();
+        if (found) {
+            cycle = cuckoo::Cycle{ctx.sols.begin(), ctx.sols.end()};
+        }
 
-    if (found) {
-        copy(ctx.sols.begin(), ctx.sols.begin() + ctx.sols.size(), inserter(cycle, cycle.begin()));
+        return found;
     }
 
-    return found;
-}
+    uint8_t EdgeBits() const override { return EDGEBITS; }
+    size_t Threads() const override { return nThreads; }
+    uint64_t MemoryUsage() const override { return ctx.trimmer->alloc.Allocated(); }
 
-bool FindCycleAdvanced(const uint256& hash,
+    cuckoo::SolverStats Stats() const override
+    {
+        auto stats = ctx.stats;
+        stats.roundMicros = ctx.trimmer->roundMicros;
+        return stats;
+    }
+
+private:
+    size_t nThreads;
+    solver_ctx<offset_t, EDGEBITS, XBITS> ctx;
+};
+
+namespace cuckoo
+{
+
+std::unique_ptr<Solver> MakeSolver(
     uint8_t edgeBits,
     uint8_t proofSize,
-    std::set<uint32_t>& cycle,
     size_t nThreads,
-    ctpl::thread_pool& pool)
+    bool hugePages)
 {
     switch (edgeBits) {
     case 16:
-        return run<uint32_t, 16u, 0u>(hash, proofSize, cycle, nThreads, pool);
+        return std::unique_ptr<Solver>{new MeanSolver<uint32_t, 16u, 0u>(nThreads, proofSize, hugePages)};
     case 17:
-        return run<uint32_t, 17u, 1u>(hash, proofSize, cycle, nThreads, pool);
+        return std::unique_ptr<Solver>{new MeanSolver<uint32_t, 17u, 1u>(nThreads, proofSize, hugePages)};
     case 18:
-        return run<uint32_t, 18u, 1u>(hash, proofSize, cycle, nThreads, pool);
+        return std::unique_ptr<Solver>{new MeanSolver<uint32_t, 18u, 1u>(nThreads, proofSize, hugePages)};
     case 19:
-        return run<uint32_t, 19u, 2u>(hash, proofSize, cycle, nThreads, pool);
+        return std::unique_ptr<Solver>{new MeanSolver<uint32_t, 19u, 2u>(nThreads, proofSize, hugePages)};
     case 20:
-        return run<uint32_t, 20u, 2u>(hash, proofSize, cycle, nThreads, pool);
+        return std::unique_ptr<Solver>{new MeanSolver<uint32_t, 20u, 2u>(nThreads, proofSize, hugePages)};
     case 21:
-        return run<uint32_t, 21u, 3u>(hash, proofSize, cycle, nThreads, pool);
+        return std::unique_ptr<Solver>{new MeanSolver<uint32_t, 21u, 3u>(nThreads, proofSize, hugePages)};
     case 22:
-        return run<uint32_t, 22u, 3u>(hash, proofSize, cycle, nThreads, pool);
+        return std::unique_ptr<Solver>{new MeanSolver<uint32_t, 22u, 3u>(nThreads, proofSize, hugePages)};
     case 23:
-        return run<uint32_t, 23u, 4u>(hash, proofSize, cycle, nThreads, pool);
+        return std::unique_ptr<Solver>{new MeanSolver<uint32_t, 23u, 4u>(nThreads, proofSize, hugePages)};
     case 24:
-        return run<uint32_t, 24u, 4u>(hash, proofSize, cycle, nThreads, pool);
+        return std::unique_ptr<Solver>{new MeanSolver<uint32_t, 24u, 4u>(nThreads, proofSize, hugePages)};
     case 25:
-        return run<uint32_t, 25u, 5u>(hash, proofSize, cycle, nThreads, pool);
+        return std::unique_ptr<Solver>{new MeanSolver<uint32_t, 25u, 5u>(nThreads, proofSize, hugePages)};
     case 26:
-        return run<uint32_t, 26u, 5u>(hash, proofSize, cycle, nThreads, pool);
+        return std::unique_ptr<Solver>{new MeanSolver<uint32_t, 26u, 5u>(nThreads, proofSize, hugePages)};
     case 27:
-        return run<uint32_t, 27u, 6u>(hash, proofSize, cycle, nThreads, pool);
+        return std::unique_ptr<Solver>{new MeanSolver<uint32_t, 27u, 6u>(nThreads, proofSize, hugePages)};
     case 28:
-        return run<uint32_t, 28u, 6u>(hash, proofSize, cycle, nThreads, pool);
+        return std::unique_ptr<Solver>{new MeanSolver<uint32_t, 28u, 6u>(nThreads, proofSize, hugePages)};
     case 29:
-        return run<uint32_t, 29u, 7u>(hash, proofSize, cycle, nThreads, pool);
+        return std::unique_ptr<Solver>{new MeanSolver<uint32_t, 29u, 7u>(nThreads, proofSize, hugePages)};
     case 30:
-        return run<uint64_t, 30u, 8u>(hash, proofSize, cycle, nThreads, pool);
+        return std::unique_ptr<Solver>{new MeanSolver<uint64_t, 30u, 8u>(nThreads, proofSize, hugePages)};
     case 31:
-        return run<uint64_t, 31u, 8u>(hash, proofSize, cycle, nThreads, pool);
+        return std::unique_ptr<Solver>{new MeanSolver<uint64_t, 31u, 8u>(nThreads, proofSize, hugePages)};
 
     default:
         throw std::runtime_error(strprintf("%s: EDGEBITS equal to %d is not suppoerted", __func__, edgeBits));
     }
 }
+
+}
+
+bool FindCycleAdvanced(const uint256& hash,
+    uint8_t edgeBits,
+    uint8_t proofSize,
+    cuckoo::Cycle& cycle,
+    size_t nThreads)
+{
+    auto solver = cuckoo::MakeSolver(edgeBits, proofSize, nThreads);
+    return solver->Solve(hash, cycle);
+}
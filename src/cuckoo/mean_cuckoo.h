@@ -5,19 +5,70 @@
 #ifndef MERIT_CUCKOO_MEAN_CUCKOO_H
 #define MERIT_CUCKOO_MEAN_CUCKOO_H
 
+#include "cuckoo/cycle.h"
 #include "uint256.h"
-#include "ctpl/ctpl.h"
 
-#include <set>
+#include <memory>
 #include <vector>
 
+namespace cuckoo
+{
+
+/**
+ * Timings a solver accumulated over all the graphs it solved. Round
+ * timings are taken by the first thread of the team and include waiting
+ * for the other threads to finish the round.
+ */
+struct SolverStats
+{
+    uint64_t graphs = 0;
+    int64_t trimMicros = 0;
+    int64_t cycleMicros = 0;
+    std::vector<int64_t> roundMicros;
+};
+
+/**
+ * Mean miner solver which outlives a single nonce. It owns the bucket
+ * matrices for its edge bits and thread count, so they are allocated and
+ * page-faulted once and every Solve call only rekeys the siphash keys.
+ * It also owns the team of threads it trims with; the thread calling
+ * Solve is one of them.
+ */
+class Solver
+{
+public:
+    virtual ~Solver() {}
+
+    // Find proofsize-length cuckoo cycle in the graph generated by hash
+    virtual bool Solve(const uint256& hash, Cycle& cycle) = 0;
+
+    virtual uint8_t EdgeBits() const = 0;
+    virtual size_t Threads() const = 0;
+
+    // Bytes held by the solver buffers
+    virtual uint64_t MemoryUsage() const = 0;
+
+    virtual SolverStats Stats() const = 0;
+};
+
+/**
+ * Create solver for the given edge bits and number of threads. With hugePages
+ * set the solver buffers are mmap-ed and backed by huge pages if available.
+ */
+std::unique_ptr<Solver> MakeSolver(
+    uint8_t edgeBits,
+    uint8_t proofSize,
+    size_t nThreads,
+    bool hugePages = false);
+
+}
+
 // Find proofsize-length cuckoo cycle in random graph
 bool FindCycleAdvanced(
     const uint256& hash,
     uint8_t edgeBits,
     uint8_t proofSize,
-    std::set<uint32_t>& cycle,
-    size_t threads_number,
-    ctpl::thread_pool&);
+    cuckoo::Cycle& cycle,
+    size_t threads_number);
 
 #endif // MERIT_CUCKOO_MEAN_CUCKOO_H
@@ -11,7 +11,6 @@
 
 #include <assert.h>
 #include <numeric>
-#include <set>
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
@@ -25,7 +24,7 @@ bool VerifyProofOfWork(
         uint256 hash,
         unsigned int nBits,
         uint8_t edgeBits,
-        const std::set<uint32_t>& cycle,
+        const Cycle& cycle,
         const Consensus::Params& params)
 {
 
@@ -39,9 +38,7 @@ bool VerifyProofOfWork(
 
     assert(edgeBits >= MIN_EDGE_BITS && edgeBits <= MAX_EDGE_BITS);
 
-    std::vector<uint32_t> vCycle{cycle.begin(), cycle.end()};
-
-    int res = VerifyCycle(hash, edgeBits, params.nCuckooProofSize, vCycle);
+    int res = VerifyCycle(hash, edgeBits, params.nCuckooProofSize, cycle);
 
     if (res == verify_code::POW_OK) {
         // check that hash of a cycle is less than a difficulty (old school bitcoin pow)
@@ -51,18 +48,110 @@ bool VerifyProofOfWork(
     return false;
 }
 
+std::vector<bool> VerifyProofsOfWork(
+        const std::vector<ProofOfWork>& proofs,
+        const Consensus::Params& params)
+{
+    const uint8_t proofSize = params.nCuckooProofSize;
+    std::vector<bool> valid(proofs.size(), false);
+
+    // proofs which pass the cheap checks and the inputs of the siphashes of
+    // their edge endpoints, u and v of every edge in turn
+    std::vector<size_t> checked;
+    std::vector<uint64_t> k0s, k1s, nonces;
+    checked.reserve(proofs.size());
+    k0s.reserve(2 * proofSize * proofs.size());
+    k1s.reserve(2 * proofSize * proofs.size());
+    nonces.reserve(2 * proofSize * proofs.size());
+
+    for (size_t i = 0; i < proofs.size(); i++) {
+        const auto& proof = proofs[i];
+        const auto& cycle = *proof.cycle;
+
+        if (cycle.size() != proofSize) {
+            continue;
+        }
+
+        if (!params.sEdgeBitsAllowed.count(proof.edgeBits)) {
+            continue;
+        }
+
+        assert(proof.edgeBits >= MIN_EDGE_BITS && proof.edgeBits <= MAX_EDGE_BITS);
+
+        // nonces of a cycle are ascending, so only the largest can be too big
+        const uint32_t edgeMask = (1 << proof.edgeBits) - 1;
+        if (cycle.back() > edgeMask) {
+            continue;
+        }
+
+        siphash_keys keys;
+        setKeys(proof.hash, &keys);
+
+        for (const auto nonce : cycle) {
+            for (uint32_t uorv = 0; uorv < 2; uorv++) {
+                k0s.push_back(keys.k0);
+                k1s.push_back(keys.k1);
+                nonces.push_back(2 * nonce + uorv);
+            }
+        }
+
+        checked.push_back(i);
+    }
+
+    std::vector<uint64_t> hashes(nonces.size());
+    siphash24xN(k0s.data(), k1s.data(), nonces.data(), hashes.data(), nonces.size());
+
+    std::vector<uint32_t> uvs(2 * proofSize);
+    for (size_t c = 0; c < checked.size(); c++) {
+        const auto& proof = proofs[checked[c]];
+        const uint32_t edgeMask = (1 << proof.edgeBits) - 1;
+
+        for (size_t n = 0; n < uvs.size(); n++) {
+            const uint32_t uorv = n & 1;
+            uvs[n] = (hashes[c * uvs.size() + n] & edgeMask) << 1 | uorv;
+        }
+
+        if (VerifyCycleNodes(uvs.data(), proofSize) != verify_code::POW_OK) {
+            continue;
+        }
+
+        // check that hash of a cycle is less than a difficulty (old school bitcoin pow)
+        valid[checked[c]] = ::CheckProofOfWork(SerializeHash(*proof.cycle), proof.nBits, params);
+    }
+
+    return valid;
+}
+
 bool FindProofOfWorkAdvanced(
     const uint256 hash,
     unsigned int nBits,
     uint8_t edgeBits,
-    std::set<uint32_t>& cycle,
+    Cycle& cycle,
     const Consensus::Params& params,
-    size_t nThreads,
-    ctpl::thread_pool& pool)
+    size_t nThreads)
 {
     assert(cycle.empty());
     bool cycleFound =
-        FindCycleAdvanced(hash, edgeBits, params.nCuckooProofSize, cycle, nThreads, pool);
+        FindCycleAdvanced(hash, edgeBits, params.nCuckooProofSize, cycle, nThreads);
+
+    if (cycleFound && ::CheckProofOfWork(SerializeHash(cycle), nBits, params)) {
+        return true;
+    }
+
+    cycle.clear();
+
+    return false;
+}
+
+bool FindProofOfWorkAdvanced(
+    const uint256 hash,
+    unsigned int nBits,
+    Cycle& cycle,
+    const Consensus::Params& params,
+    Solver& solver)
+{
+    assert(cycle.empty());
+    bool cycleFound = solver.Solve(hash, cycle);
 
     if (cycleFound && ::CheckProofOfWork(SerializeHash(cycle), nBits, params)) {
         return true;
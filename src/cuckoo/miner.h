@@ -8,8 +8,8 @@
 #include "chain.h"
 #include "consensus/params.h"
 #include "uint256.h"
-#include "ctpl/ctpl.h"
-#include <set>
+#include "cuckoo/cycle.h"
+#include "cuckoo/mean_cuckoo.h"
 #include <vector>
 
 namespace cuckoo
@@ -23,7 +23,28 @@ bool VerifyProofOfWork(
         uint256 hash,
         unsigned int nBits,
         uint8_t edgeBits,
-        const std::set<uint32_t>& cycle,
+        const Cycle& cycle,
+        const Consensus::Params& params);
+
+/**
+ * A block hash along with the proof-of-work fields of its header.
+ */
+struct ProofOfWork
+{
+    uint256 hash;
+    unsigned int nBits;
+    uint8_t edgeBits;
+    const Cycle* cycle;
+};
+
+/**
+ * Check many proofs of work together, with the same result as calling
+ * VerifyProofOfWork on every one of them. The edge endpoints of all the
+ * cycles are hashed in one pass, several of them at a time with AVX2.
+ * Returns one result per proof, in order.
+ */
+std::vector<bool> VerifyProofsOfWork(
+        const std::vector<ProofOfWork>& proofs,
         const Consensus::Params& params);
 
 /**
@@ -34,10 +55,21 @@ bool FindProofOfWorkAdvanced(
         uint256 hash,
         unsigned int nBits,
         uint8_t edgeBits,
-        std::set<uint32_t>& cycle,
+        Cycle& cycle,
+        const Consensus::Params& params,
+        size_t nThreads);
+
+/**
+ * Find cycle for block that satisfies the proof-of-work requirement
+ * specified by block hash reusing solver buffers between calls.
+ * The edge bits are the ones the solver was created with.
+ */
+bool FindProofOfWorkAdvanced(
+        uint256 hash,
+        unsigned int nBits,
+        Cycle& cycle,
         const Consensus::Params& params,
-        size_t nThreads,
-        ctpl::thread_pool& pool);
+        Solver& solver);
 }
 
 #endif // MERIT_CUCKOO_MINER_H
@@ -0,0 +1,153 @@
+// Copyright (c) 2017-2018 The Merit Foundation developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "cuckoo/solver_pool.h"
+
+#include <cassert>
+#include <list>
+#include <mutex>
+#include <vector>
+
+namespace cuckoo
+{
+
+namespace
+{
+struct IdleSolver
+{
+    SolverKey key;
+    std::unique_ptr<Solver> solver;
+    uint64_t memory;
+};
+
+std::mutex mPool;
+// least recently returned first
+std::list<IdleSolver> lIdle;
+uint64_t nLimit = DEFAULT_SOLVER_POOL_LIMIT;
+SolverPoolStats stats;
+
+// Free the least recently returned solvers until the idle ones fit in the
+// limit. The caller destroys them after releasing the lock as it joins
+// their threads.
+void Evict(std::vector<std::unique_ptr<Solver>>& evicted)
+{
+    while (!lIdle.empty() && stats.idleMemory > nLimit) {
+        auto& idle = lIdle.front();
+        stats.idleMemory -= idle.memory;
+        stats.idle--;
+        stats.evicted++;
+        evicted.push_back(std::move(idle.solver));
+        lIdle.pop_front();
+    }
+}
+
+void Release(std::unique_ptr<Solver> solver, const SolverKey& key)
+{
+    std::vector<std::unique_ptr<Solver>> evicted;
+    {
+        std::lock_guard<std::mutex> lock{mPool};
+        assert(stats.inUse > 0);
+        stats.inUse--;
+
+        const auto memory = solver->MemoryUsage();
+        stats.idleMemory += memory;
+        stats.idle++;
+        lIdle.push_back(IdleSolver{key, std::move(solver), memory});
+
+        Evict(evicted);
+    }
+}
+}
+
+SolverLease::SolverLease(std::unique_ptr<Solver> solverIn, const SolverKey& keyIn) : solver{std::move(solverIn)}, key(keyIn) {}
+
+SolverLease::~SolverLease()
+{
+    reset();
+}
+
+SolverLease::SolverLease(SolverLease&& other) : solver{std::move(other.solver)}, key(other.key) {}
+
+SolverLease& SolverLease::operator=(SolverLease&& other)
+{
+    if (this != &other) {
+        reset();
+        solver = std::move(other.solver);
+        key = other.key;
+    }
+    return *this;
+}
+
+void SolverLease::reset()
+{
+    if (solver) {
+        Release(std::move(solver), key);
+    }
+}
+
+SolverLease AcquireSolver(
+    uint8_t edgeBits,
+    uint8_t proofSize,
+    size_t nThreads,
+    bool hugePages)
+{
+    const SolverKey key{edgeBits, proofSize, nThreads, hugePages};
+
+    {
+        std::lock_guard<std::mutex> lock{mPool};
+        stats.inUse++;
+
+        // the most recently returned solver is the most likely to be warm
+        for (auto it = lIdle.rbegin(); it != lIdle.rend(); ++it) {
+            if (it->key == key) {
+                auto solver = std::move(it->solver);
+                stats.idleMemory -= it->memory;
+                lIdle.erase(std::next(it).base());
+                stats.idle--;
+                stats.reused++;
+                return SolverLease{std::move(solver), key};
+            }
+        }
+
+        stats.created++;
+    }
+
+    try {
+        return SolverLease{MakeSolver(edgeBits, proofSize, nThreads, hugePages), key};
+    } catch (...) {
+        std::lock_guard<std::mutex> lock{mPool};
+        stats.created--;
+        stats.inUse--;
+        throw;
+    }
+}
+
+void SetSolverPoolLimit(uint64_t nBytes)
+{
+    std::vector<std::unique_ptr<Solver>> evicted;
+    {
+        std::lock_guard<std::mutex> lock{mPool};
+        nLimit = nBytes;
+        Evict(evicted);
+    }
+}
+
+SolverPoolStats GetSolverPoolStats()
+{
+    std::lock_guard<std::mutex> lock{mPool};
+    return stats;
+}
+
+void ClearSolverPool()
+{
+    std::list<IdleSolver> cleared;
+    {
+        std::lock_guard<std::mutex> lock{mPool};
+        cleared.swap(lIdle);
+        stats.idle = 0;
+        stats.idleMemory = 0;
+    }
+}
+
+}
@@ -0,0 +1,105 @@
+// Copyright (c) 2017-2018 The Merit Foundation developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef MERIT_CUCKOO_SOLVER_POOL_H
+#define MERIT_CUCKOO_SOLVER_POOL_H
+
+#include "cuckoo/mean_cuckoo.h"
+
+#include <cstdint>
+#include <memory>
+
+namespace cuckoo
+{
+
+/** Default for -minesolvercache, the most memory idle solvers may hold */
+static const uint64_t DEFAULT_SOLVER_POOL_LIMIT = 512 << 20;
+
+/**
+ * How the solvers handed out by the pool were obtained. Memory is the bytes
+ * held by the solver buffers.
+ */
+struct SolverPoolStats
+{
+    uint64_t created = 0;
+    uint64_t reused = 0;
+    uint64_t evicted = 0;
+    uint64_t inUse = 0;
+    uint64_t idle = 0;
+    uint64_t idleMemory = 0;
+};
+
+struct SolverKey
+{
+    uint8_t edgeBits;
+    uint8_t proofSize;
+    size_t nThreads;
+    bool hugePages;
+
+    bool operator==(const SolverKey& other) const
+    {
+        return edgeBits == other.edgeBits &&
+               proofSize == other.proofSize &&
+               nThreads == other.nThreads &&
+               hugePages == other.hugePages;
+    }
+};
+
+/**
+ * Solver borrowed from the pool, which it goes back to once the lease is
+ * reset or destroyed. It is used like the std::unique_ptr MakeSolver
+ * returns.
+ */
+class SolverLease
+{
+public:
+    SolverLease() {}
+    SolverLease(std::unique_ptr<Solver> solverIn, const SolverKey& keyIn);
+    ~SolverLease();
+
+    SolverLease(SolverLease&& other);
+    SolverLease& operator=(SolverLease&& other);
+
+    SolverLease(const SolverLease&) = delete;
+    SolverLease& operator=(const SolverLease&) = delete;
+
+    void reset();
+
+    Solver& operator*() const { return *solver; }
+    Solver* operator->() const { return solver.get(); }
+    explicit operator bool() const { return static_cast<bool>(solver); }
+
+private:
+    std::unique_ptr<Solver> solver;
+    SolverKey key{};
+};
+
+/**
+ * Borrow a solver from the process-wide pool of idle solvers, or create one
+ * if none of them was created with the same arguments. A solver keeps its
+ * buffers and its team of threads while idle, so generateBlocks calls and
+ * mining sessions which follow each other skip the thread startup and the
+ * allocation and page faulting of the buffers.
+ */
+SolverLease AcquireSolver(
+    uint8_t edgeBits,
+    uint8_t proofSize,
+    size_t nThreads,
+    bool hugePages = false);
+
+/**
+ * Set the most memory idle solvers may hold. The least recently returned
+ * ones are freed to stay under it, and a solver larger than the limit is
+ * freed as soon as it is returned.
+ */
+void SetSolverPoolLimit(uint64_t nBytes);
+
+SolverPoolStats GetSolverPoolStats();
+
+// Free all idle solvers
+void ClearSolverPool();
+
+}
+
+#endif // MERIT_CUCKOO_SOLVER_POOL_H
@@ -0,0 +1,114 @@
+// Copyright (c) 2017-2018 The Merit Foundation developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "cuckoo/solver_team.h"
+
+#include <cassert>
+#include <x86intrin.h>
+
+namespace cuckoo
+{
+
+namespace
+{
+// a few microseconds worth of pause instructions
+const size_t SPINS_BEFORE_PARKING = 4096;
+}
+
+SpinBarrier::SpinBarrier(size_t nThreadsIn, size_t nSpinsIn) : nThreads{nThreadsIn},
+                                                                nSpins{nSpinsIn},
+                                                                nCount{nThreadsIn},
+                                                                nGeneration{0},
+                                                                nParked{0}
+{
+    assert(nThreads > 0);
+}
+
+void SpinBarrier::Wait()
+{
+    const auto nGen = nGeneration.load();
+
+    if (nCount.fetch_sub(1) == 1) {
+        nCount.store(nThreads);
+        nGeneration.fetch_add(1);
+
+        // a thread which parked after this check sees the new generation
+        // before going to sleep
+        if (nParked.load() > 0) {
+            std::lock_guard<std::mutex> lLock{mMutex};
+            cv.notify_all();
+        }
+        return;
+    }
+
+    for (size_t i = 0; i < nSpins; i++) {
+        if (nGeneration.load(std::memory_order_acquire) != nGen) {
+            return;
+        }
+        _mm_pause();
+    }
+
+    std::unique_lock<std::mutex> lLock{mMutex};
+    nParked++;
+    cv.wait(lLock, [this, nGen] { return nGeneration.load() != nGen; });
+    nParked--;
+}
+
+size_t DefaultSpins(size_t nThreads)
+{
+    const size_t nCores = std::thread::hardware_concurrency();
+    return nCores > 0 && nThreads <= nCores ? SPINS_BEFORE_PARKING : 0;
+}
+
+SolverTeam::SolverTeam(size_t nThreadsIn) : nThreads{nThreadsIn},
+                                            barrier{nThreadsIn, DefaultSpins(nThreadsIn)}
+{
+    vWorkers.reserve(nThreads - 1);
+    for (size_t t = 1; t < nThreads; t++) {
+        vWorkers.emplace_back(&SolverTeam::Work, this, t);
+    }
+}
+
+SolverTeam::~SolverTeam()
+{
+    if (vWorkers.empty()) {
+        return;
+    }
+
+    fStop = true;
+    barrier.Wait();
+
+    for (auto& worker : vWorkers) {
+        worker.join();
+    }
+}
+
+void SolverTeam::Run(const Job& job)
+{
+    if (nThreads == 1) {
+        job(0);
+        return;
+    }
+
+    pJob = &job;
+    barrier.Wait();
+    job(0);
+    barrier.Wait();
+    pJob = nullptr;
+}
+
+void SolverTeam::Work(uint32_t id)
+{
+    while (true) {
+        barrier.Wait();
+        if (fStop) {
+            return;
+        }
+
+        (*pJob)(id);
+        barrier.Wait();
+    }
+}
+
+}
@@ -0,0 +1,86 @@
+// Copyright (c) 2017-2018 The Merit Foundation developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef MERIT_CUCKOO_SOLVER_TEAM_H
+#define MERIT_CUCKOO_SOLVER_TEAM_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace cuckoo
+{
+
+/**
+ * Barrier which spins for a while before parking the waiting thread.
+ * Trimming rounds are short and evenly split between threads, so most
+ * waits end while spinning and only the last thread to arrive writes
+ * to shared state. The mutex is only taken if somebody is parked.
+ */
+class SpinBarrier
+{
+public:
+    SpinBarrier(size_t nThreadsIn, size_t nSpinsIn);
+
+    SpinBarrier(const SpinBarrier&) = delete;
+    SpinBarrier& operator=(const SpinBarrier&) = delete;
+
+    void Wait();
+
+private:
+    const size_t nThreads;
+    const size_t nSpins;
+    std::atomic<size_t> nCount;
+    std::atomic<size_t> nGeneration;
+    std::atomic<size_t> nParked;
+    std::mutex mMutex;
+    std::condition_variable cv;
+};
+
+/**
+ * Number of spins before a waiting thread parks. Spinning only pays off
+ * if every thread of the team has a core of its own, otherwise waiting
+ * threads park right away.
+ */
+size_t DefaultSpins(size_t nThreads);
+
+/**
+ * Fixed team of threads which live as long as the solver. The thread
+ * calling Run is member 0 and the other members wait on a barrier between
+ * jobs, so starting a job is a barrier phase flip instead of queueing
+ * tasks and waking threads up.
+ */
+class SolverTeam
+{
+public:
+    using Job = std::function<void(uint32_t)>;
+
+    explicit SolverTeam(size_t nThreadsIn);
+    ~SolverTeam();
+
+    SolverTeam(const SolverTeam&) = delete;
+    SolverTeam& operator=(const SolverTeam&) = delete;
+
+    // Run job(id) for every member id and return when all of them are done
+    void Run(const Job& job);
+
+    size_t Threads() const { return nThreads; }
+
+private:
+    void Work(uint32_t id);
+
+    const size_t nThreads;
+    SpinBarrier barrier;
+    const Job* pJob = nullptr;
+    bool fStop = false;
+    std::vector<std::thread> vWorkers;
+};
+
+}
+
+#endif // MERIT_CUCKOO_SOLVER_TEAM_H
@@ -191,8 +191,11 @@ bool CDBWrapper::IsEmpty()
 }
 
 CDBIterator::~CDBIterator() { delete piter; }
-bool CDBIterator::Valid() const { return piter->Valid(); }
-void CDBIterator::SeekToFirst() { piter->SeekToFirst(); }
+bool CDBIterator::Valid() const
+{
+    return piter->Valid() && (prefix.empty() || piter->key().starts_with(leveldb::Slice(prefix)));
+}
+void CDBIterator::SeekToFirst() { prefix.clear(); piter->SeekToFirst(); }
 void CDBIterator::Next() { piter->Next(); }
 
 namespace dbwrapper_private {
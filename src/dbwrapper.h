@@ -14,6 +14,8 @@
 #include "utilstrencodings.h"
 #include "version.h"
 
+#include <algorithm>
+
 #include <leveldb/db.h>
 #include <leveldb/write_batch.h>
 
@@ -120,6 +122,15 @@ class CDBIterator
 private:
     const CDBWrapper &parent;
     leveldb::Iterator *piter;
+    //! serialized key prefix bounding the iteration, empty if unbounded
+    std::string prefix;
+
+    template<typename K> static std::string SerializeKey(const K& key) {
+        CDataStream ssKey(SER_DISK, CLIENT_VERSION);
+        ssKey.reserve(DBWRAPPER_PREALLOC_KEY_SIZE);
+        ssKey << key;
+        return std::string(ssKey.data(), ssKey.size());
+    }
 
 public:
 
@@ -136,11 +147,40 @@ public:
     void SeekToFirst();
 
     template<typename K> void Seek(const K& key) {
-        CDataStream ssKey(SER_DISK, CLIENT_VERSION);
-        ssKey.reserve(DBWRAPPER_PREALLOC_KEY_SIZE);
-        ssKey << key;
-        leveldb::Slice slKey(ssKey.data(), ssKey.size());
-        piter->Seek(slKey);
+        prefix.clear();
+        const std::string strKey = SerializeKey(key);
+        piter->Seek(leveldb::Slice(strKey));
+    }
+
+    /**
+     * Seek to the first key starting with the serialized prefix. The
+     * iterator stops being Valid() past the last key with that prefix, so
+     * scanning one key family never walks the rest of the database.
+     */
+    template<typename P> void SeekPrefix(const P& key_prefix) {
+        prefix = SerializeKey(key_prefix);
+        piter->Seek(leveldb::Slice(prefix));
+    }
+
+    /** Like SeekPrefix, but start at the first key not before start. */
+    template<typename P, typename K> void SeekPrefix(const P& key_prefix, const K& start) {
+        prefix = SerializeKey(key_prefix);
+        const std::string strStart = std::max(prefix, SerializeKey(start));
+        piter->Seek(leveldb::Slice(strStart));
+    }
+
+    /**
+     * Seek to the last key before key, or past the end if there is none.
+     * Used to find the latest entry of a family whose keys end in a
+     * big-endian height below a given height.
+     */
+    template<typename K> void SeekBefore(const K& key) {
+        Seek(key);
+        if (piter->Valid()) {
+            piter->Prev();
+        } else {
+            piter->SeekToLast();
+        }
     }
 
     void Next();
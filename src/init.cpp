@@ -17,6 +17,7 @@
 #include "checkpoints.h"
 #include "compat/sanity.h"
 #include "consensus/validation.h"
+#include "cuckoo/solver_pool.h"
 #include "fs.h"
 #include "httpserver.h"
 #include "httprpc.h"
@@ -197,6 +198,7 @@ void Shutdown()
     }
 #endif
     GenerateMerit(false, 0, 0, 0, Params());
+    cuckoo::ClearSolverPool();
     MapPort(false);
     UnregisterValidationInterface(peerLogic.get());
     peerLogic.reset();
@@ -356,6 +358,8 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-minepowthreads=<n>", strprintf(_("Set the number of threads for pow attempt if enabled (-1 = all cores, default: %d)"), DEFAULT_MINING_POW_THREADS));
     strUsage += HelpMessageOpt("-minebucketsize=<n>", strprintf(_("Set the number of nonces to check by one bucket (0 - unlimited) (default: %d)"), DEFAULT_MINING_BUCKET_SIZE));
     strUsage += HelpMessageOpt("-minebucketthreads=<n>", strprintf(_("Set the number of buckets run in parrallel (default: %d)"), DEFAULT_MINING_BUCKET_THREADS));
+    strUsage += HelpMessageOpt("-minehugepages", strprintf(_("Back the pow solver memory with huge pages if available (default: %u)"), DEFAULT_MINING_HUGE_PAGES));
+    strUsage += HelpMessageOpt("-minesolvercache=<n>", strprintf(_("Keep up to <n> megabytes of idle pow solvers for later mining and block generation (default: %u)"), cuckoo::DEFAULT_SOLVER_POOL_LIMIT >> 20));
 
     strUsage += HelpMessageOpt("-datadir=<dir>", _("Specify data directory"));
     if (showDebug) {
@@ -369,6 +373,7 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-maxmempool=<n>", strprintf(_("Keep the transaction memory pool below <n> megabytes (default: %u)"), DEFAULT_MAX_MEMPOOL_SIZE));
     strUsage += HelpMessageOpt("-mempoolexpiry=<n>", strprintf(_("Do not keep transactions in the mempool longer than <n> hours (default: %u)"), DEFAULT_MEMPOOL_EXPIRY));
     strUsage += HelpMessageOpt("-maxrefmempool=<n>", strprintf(_("Keep the referrals memory pool below <n> megabytes (default: %u)"), DEFAULT_MAX_REFERRALS_MEMPOOL_SIZE));
+    strUsage += HelpMessageOpt("-referralcache=<n>", strprintf(_("Keep at most <n> referrals and <n> unbeaconed addresses in memory (default: %u)"), referral::DEFAULT_REFERRALS_CACHE_SIZE));
     strUsage += HelpMessageOpt("-refmempoolexpiry=<n>", strprintf(_("Do not keep referrals in the mempool longer than <n> hours (default: %u)"), DEFAULT_REFERRALS_MEMPOOL_EXPIRY));
     if (showDebug) {
         strUsage += HelpMessageOpt("-minimumchainwork=<hex>", strprintf("Minimum work assumed to exist on a valid chain in hex (default: %s, testnet: %s)", defaultChainParams->GetConsensus().nMinimumChainWork.GetHex(), testnetChainParams->GetConsensus().nMinimumChainWork.GetHex()));
@@ -1257,11 +1262,15 @@ bool AppInitMain(boost::thread_group& threadGroup, CScheduler& scheduler)
 
     InitSignatureCache();
     InitScriptExecutionCache();
+    InitReferralSignatureCache();
 
-    LogPrintf("Using %u threads for script verification\n", nScriptCheckThreads);
+    LogPrintf("Using %u threads for script, referral and proof of work verification\n", nScriptCheckThreads);
     if (nScriptCheckThreads) {
-        for (int i=0; i<nScriptCheckThreads-1; i++)
+        for (int i=0; i<nScriptCheckThreads-1; i++) {
             threadGroup.create_thread(&ThreadScriptCheck);
+            threadGroup.create_thread(&ThreadReferralCheck);
+            threadGroup.create_thread(&ThreadProofOfWorkCheck);
+        }
     }
 
     // Start the lightweight task scheduler thread
@@ -1442,6 +1451,7 @@ bool AppInitMain(boost::thread_group& threadGroup, CScheduler& scheduler)
     nCoinCacheUsage = nTotalCache; // the rest goes to in-memory cache
     int64_t nMempoolSizeMax = gArgs.GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000;
     int64_t nReferralsMempoolSizeMax = gArgs.GetArg("-maxrefmempool", DEFAULT_MAX_REFERRALS_MEMPOOL_SIZE) * 1000000;
+    size_t nReferralsCacheSize = std::max<int64_t>(0, gArgs.GetArg("-referralcache", referral::DEFAULT_REFERRALS_CACHE_SIZE));
     LogPrintf("Cache configuration:\n");
     LogPrintf("* Max cache setting possible %.1fMiB\n", nMaxDbCache);
     LogPrintf("* Using %.1fMiB for block index database\n", nBlockTreeDBCache * (1.0 / 1024 / 1024));
@@ -1450,6 +1460,7 @@ bool AppInitMain(boost::thread_group& threadGroup, CScheduler& scheduler)
         nCoinCacheUsage * (1.0 / 1024 / 1024),
         nMempoolSizeMax * (1.0 / 1024 / 1024),
         nReferralsMempoolSizeMax * (1.0 / 1024 / 1024));
+    LogPrintf("* Keeping up to %u referrals and %u missing addresses in memory\n", nReferralsCacheSize, nReferralsCacheSize);
 
     bool fLoaded = false;
     while (!fLoaded && !fRequestShutdown) {
@@ -1473,10 +1484,19 @@ bool AppInitMain(boost::thread_group& threadGroup, CScheduler& scheduler)
 
                 // TODO: Re-evaluate this placement of the RefDB and Cache.  There may be a more efficient place.
                 prefviewdb = new referral::ReferralsViewDB{nReferralDBCache, false, fReset || fReindexChainState};
-                prefviewcache = new referral::ReferralsViewCache{prefviewdb};
+                prefviewcache = new referral::ReferralsViewCache{prefviewdb, nReferralsCacheSize};
+
+                // If necessary, upgrade from older referral database format.
+                // This is a no-op if we cleared it with -reindex or -reindex-chainstate
+                if (!prefviewdb->Upgrade()) {
+                    strLoadError = _("Error upgrading referral database");
+                    break;
+                }
 
                 if (fReset) {
                     pblocktree->WriteReindexing(true);
+                    // the wiped address index and its balances start out in step
+                    pblocktree->WriteFlag("addressbalanceindex", true);
                     //If we're reindexing in prune mode, wipe away unusable block files and all undo data files
                     if (fPruneMode)
                         CleanupBlockRevFiles();
@@ -1538,6 +1558,20 @@ bool AppInitMain(boost::thread_group& threadGroup, CScheduler& scheduler)
                 pcoinsTip = new CCoinsViewCache(pcoinscatcher);
 
                 bool is_coinsview_empty = fReset || fReindexChainState || pcoinsTip->GetBestBlock().IsNull();
+
+                // The referral db is flushed right before the chainstate so
+                // both should be at the same block. The two writes are not
+                // atomic though, and if the node stopped between them the
+                // referral db is ahead. Its changes can't be rolled back, so
+                // the chainstate has to be rebuilt. Databases written before
+                // the best block marker existed are not checked.
+                const uint256 referrals_best_block = prefviewdb->GetBestBlock();
+                if (!is_coinsview_empty && !referrals_best_block.IsNull() &&
+                        referrals_best_block != pcoinsTip->GetBestBlock()) {
+                    strLoadError = _("The referral database is out of sync with the chainstate, likely because the node stopped while writing them. You will need to rebuild the database using -reindex-chainstate.");
+                    break;
+                }
+
                 if (!is_coinsview_empty) {
                     // LoadChainTip sets chainActive based on pcoinsTip's best block
                     if (!LoadChainTip(chainparams, true)) {
@@ -1765,6 +1799,8 @@ bool AppInitMain(boost::thread_group& threadGroup, CScheduler& scheduler)
         return false;
     }
 
+    cuckoo::SetSolverPoolLimit(static_cast<uint64_t>(std::max<int64_t>(0, gArgs.GetArg("-minesolvercache", cuckoo::DEFAULT_SOLVER_POOL_LIMIT >> 20))) << 20);
+
     if(gArgs.GetBoolArg("-mine", DEFAULT_MINING)) {
         // Generate coins in the background
         auto pow_threads = gArgs.GetArg("-minepowthreads", DEFAULT_MINING_POW_THREADS);
@@ -14,7 +14,9 @@
 #include "consensus/merkle.h"
 #include "consensus/tx_verify.h"
 #include "consensus/validation.h"
+#include "ctpl/ctpl.h"
 #include "cuckoo/miner.h"
+#include "cuckoo/solver_pool.h"
 #include "hash.h"
 #include "net.h"
 #include "policy/feerate.h"
@@ -398,7 +400,7 @@ bool BlockAssembler::CheckReferrals(
 
     // test all referrals are signed
     for (const auto& referral: candidate_referrals) {
-        if (!CheckReferralSignature(*referral)) {
+        if (!CheckReferralSignature(*referral, false)) {
             return false;
         }
 
@@ -624,7 +626,7 @@ void BlockAssembler::AddReferrals()
         }
 
         // test all referrals are signed
-        if (!CheckReferralSignature(*ref)) {
+        if (!CheckReferralSignature(*ref, false)) {
             continue;
         }
 
@@ -938,9 +940,9 @@ struct MinerContext {
     int pow_threads;
     int threads_number;
     int nonces_per_thread;
+    bool huge_pages;
     const CChainParams& chainparams;
     std::shared_ptr<CReserveScript>& coinbase_script;
-    ctpl::thread_pool& pool;
 };
 
 void MinerWorker(int thread_id, MinerContext& ctx)
@@ -948,6 +950,11 @@ void MinerWorker(int thread_id, MinerContext& ctx)
     auto start_nonce = thread_id * ctx.nonces_per_thread;
     unsigned int nExtraNonce = 0;
 
+    // solver buffers are kept between nonces and blocks and only
+    // swapped when the edge bits of the block change. They go back to the
+    // solver pool when mining stops.
+    cuckoo::SolverLease solver;
+
     while (ctx.alive) {
         if (ctx.chainparams.MiningRequiresPeers()) {
             // Busy-wait for the network to come online so we don't waste
@@ -993,6 +1000,20 @@ void MinerWorker(int thread_id, MinerContext& ctx)
         CBlock* pblock = &pblocktemplate->block;
         assert(pblock);
 
+        if (!solver || solver->EdgeBits() != pblock->nEdgeBits) {
+            solver.reset();
+            solver = cuckoo::AcquireSolver(
+                    pblock->nEdgeBits,
+                    ctx.chainparams.GetConsensus().nCuckooProofSize,
+                    ctx.pow_threads,
+                    ctx.huge_pages);
+
+            LogPrintf("%d: MeritMiner using %u MiB for %d edge bits solver\n",
+                thread_id,
+                solver->MemoryUsage() >> 20,
+                pblock->nEdgeBits);
+        }
+
         pblock->nNonce = start_nonce;
         IncrementExtraNonce(pblock, pindexPrev, nExtraNonce);
 
@@ -1012,7 +1033,7 @@ void MinerWorker(int thread_id, MinerContext& ctx)
         auto nonces_checked = 0;
         arith_uint256 hashTarget = arith_uint256().SetCompact(pblock->nBits);
         uint256 hash;
-        std::set<uint32_t> cycle;
+        cuckoo::Cycle cycle;
 
         while (ctx.alive) {
             // Check if something found
@@ -1021,11 +1042,9 @@ void MinerWorker(int thread_id, MinerContext& ctx)
             if (cuckoo::FindProofOfWorkAdvanced(
                         pblock->GetHash(),
                         pblock->nBits,
-                        pblock->nEdgeBits,
                         cycle,
                         ctx.chainparams.GetConsensus(),
-                        ctx.pow_threads,
-                        ctx.pool)) {
+                        *solver)) {
                 // Found a solution
                 pblock->sCycle = cycle;
 
@@ -1095,6 +1114,13 @@ void MinerWorker(int thread_id, MinerContext& ctx)
             }
         }
 
+        const auto elapsed = GetTimeMillis() - nStart;
+        LogPrintf("%d: MeritMiner checked %d graphs in %8.3f seconds (%.2f graphs/s)\n",
+            thread_id,
+            nonces_checked,
+            static_cast<double>(elapsed) / 1e3,
+            elapsed > 0 ? nonces_checked * 1e3 / elapsed : 0.0);
+
         if (ctx.alive && g_connman) {
             g_connman->AddCheckedNonces(nonces_checked);
         }
@@ -1121,8 +1147,9 @@ void static MeritMiner(
         bucket_size = MAX_NONCE / bucket_threads;
     }
 
-    ctpl::thread_pool pool(bucket_threads + bucket_threads * pow_threads);
+    ctpl::thread_pool pool(bucket_threads);
     std::atomic<bool> alive{true};
+    const bool huge_pages = gArgs.GetBoolArg("-minehugepages", DEFAULT_MINING_HUGE_PAGES);
 
     try {
         // Throw an error if no script was provided.  This can happen
@@ -1142,9 +1169,9 @@ void static MeritMiner(
                 pow_threads,
                 bucket_threads,
                 bucket_size,
+                huge_pages,
                 chainparams,
-                coinbase_script,
-                pool
+                coinbase_script
             };
 
             pool.push(MinerWorker, ctx);
@@ -28,6 +28,7 @@ const bool DEFAULT_MINING = false;
 const int DEFAULT_MINING_BUCKET_SIZE = 10;
 const int DEFAULT_MINING_BUCKET_THREADS = std::thread::hardware_concurrency() / 2;
 const int DEFAULT_MINING_POW_THREADS = 2;
+const bool DEFAULT_MINING_HUGE_PAGES = false;
 
 
 /** Run the miner threads */
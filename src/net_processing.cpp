@@ -1179,6 +1179,15 @@ void static ProcessGetData(CNode* pfrom, const Consensus::Params& consensusParam
                     std::shared_ptr<const CBlock> pblock;
                     if (a_recent_block && a_recent_block->GetHash() == (*mi).second->GetBlockHash()) {
                         pblock = a_recent_block;
+                    } else if (inv.type == MSG_WITNESS_BLOCK) {
+                        // The block is stored in the format witness blocks
+                        // are sent in, so send the bytes on disk as they are
+                        // and leave pblock unset so it isn't sent again
+                        CSerializedNetMsg msg;
+                        msg.command = NetMsgType::BLOCK;
+                        if (!ReadRawBlockFromDisk(msg.data, (*mi).second, Params().MessageStart()))
+                            assert(!"cannot load block from disk");
+                        connman.PushMessage(pfrom, std::move(msg));
                     } else {
                         // Send block from disk
                         std::shared_ptr<CBlock> pblockRead = std::make_shared<CBlock>();
@@ -1188,7 +1197,7 @@ void static ProcessGetData(CNode* pfrom, const Consensus::Params& consensusParam
                     }
                     if (inv.type == MSG_BLOCK)
                         connman.PushMessage(pfrom, msgMaker.Make(SERIALIZE_TRANSACTION_NO_WITNESS, NetMsgType::BLOCK, *pblock));
-                    else if (inv.type == MSG_WITNESS_BLOCK)
+                    else if (inv.type == MSG_WITNESS_BLOCK && pblock)
                         connman.PushMessage(pfrom, msgMaker.Make(NetMsgType::BLOCK, *pblock));
                     else if (inv.type == MSG_FILTERED_BLOCK)
                     {
@@ -23,6 +23,15 @@ namespace pog
         return db.GetAllANVs();
     }
 
+    bool GetANVsAfter(
+            const referral::ReferralsViewDB& db,
+            const referral::MaybeAddress& after,
+            size_t max_count,
+            referral::AddressANVs& anvs)
+    {
+        return db.GetANVsAfter(after, max_count, anvs);
+    }
+
     void GetAllRewardableANVs(
             const referral::ReferralsViewDB& db,
             const Consensus::Params& params,
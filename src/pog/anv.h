@@ -27,6 +27,12 @@ namespace pog
 
     referral::AddressANVs GetAllANVs(const referral::ReferralsViewDB&);
 
+    bool GetANVsAfter(
+            const referral::ReferralsViewDB&,
+            const referral::MaybeAddress& after,
+            size_t max_count,
+            referral::AddressANVs&);
+
     void GetAllRewardableANVs(
             const referral::ReferralsViewDB&,
             const Consensus::Params&,
@@ -0,0 +1,260 @@
+// Copyright (c) 2017-2018 The Merit Foundation developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "pog/anvtree.h"
+
+#include <cassert>
+#include <tuple>
+
+namespace pog
+{
+    /**
+     * The tree is a treap. Nodes live in a vector and refer to each other by
+     * index, and removed nodes are reused. Priorities are random, so the
+     * shape of the tree is balanced on average but never affects which entry
+     * is selected; only the (ANV, address) order does.
+     */
+    void AnvTree::Clear()
+    {
+        m_nodes.clear();
+        m_free.clear();
+        m_index.clear();
+        m_root = NIL;
+        m_negatives = 0;
+        m_excluded_entry.reset();
+    }
+
+    void AnvTree::Insert(char address_type, const uint160& address, CAmount anv)
+    {
+        const Entry entry{address_type, address, anv};
+
+        if (m_excluded && *m_excluded == address) {
+            m_excluded_entry = entry;
+            return;
+        }
+
+        const auto it = m_index.find(address);
+        if (it != m_index.end()) {
+            Unlink(it->second);
+        }
+
+        Link(entry);
+    }
+
+    bool AnvTree::Erase(const uint160& address)
+    {
+        if (m_excluded && *m_excluded == address) {
+            const bool had_entry = static_cast<bool>(m_excluded_entry);
+            m_excluded_entry.reset();
+            return had_entry;
+        }
+
+        const auto it = m_index.find(address);
+        if (it == m_index.end()) {
+            return false;
+        }
+
+        Unlink(it->second);
+        return true;
+    }
+
+    bool AnvTree::Update(const uint160& address, CAmount anv)
+    {
+        if (m_excluded && *m_excluded == address) {
+            if (!m_excluded_entry) {
+                return false;
+            }
+            m_excluded_entry->anv = anv;
+            return true;
+        }
+
+        const auto it = m_index.find(address);
+        if (it == m_index.end()) {
+            return false;
+        }
+
+        auto entry = m_nodes[it->second].entry;
+        if (entry.anv == anv) {
+            return true;
+        }
+
+        Unlink(it->second);
+        entry.anv = anv;
+        Link(entry);
+        return true;
+    }
+
+    void AnvTree::Exclude(const uint160& address)
+    {
+        if (m_excluded && *m_excluded == address) {
+            return;
+        }
+
+        m_excluded = address;
+
+        //the previously excluded address goes back in the tree.
+        if (m_excluded_entry) {
+            const auto entry = *m_excluded_entry;
+            m_excluded_entry.reset();
+            Link(entry);
+        }
+
+        const auto it = m_index.find(address);
+        if (it != m_index.end()) {
+            m_excluded_entry = m_nodes[it->second].entry;
+            Unlink(it->second);
+        }
+    }
+
+    const AnvTree::Entry& AnvTree::Select(CAmount selected) const
+    {
+        assert(selected >= 0);
+        assert(selected < Total());
+
+        //before is the total ANV of all entries ordered before the subtree.
+        CAmount before = 0;
+        NodeIdx n = m_root;
+        while (true) {
+            assert(n != NIL);
+            const auto& node = m_nodes[n];
+
+            const auto left_sum = Sum(node.left);
+            if (node.left != NIL && before + left_sum >= selected) {
+                n = node.left;
+                continue;
+            }
+
+            before += left_sum;
+            if (before + node.entry.anv >= selected) {
+                return node.entry;
+            }
+
+            before += node.entry.anv;
+            n = node.right;
+        }
+    }
+
+    CAmount AnvTree::Total() const
+    {
+        return Sum(m_root);
+    }
+
+    size_t AnvTree::Size() const
+    {
+        return m_index.size();
+    }
+
+    size_t AnvTree::Negatives() const
+    {
+        return m_negatives;
+    }
+
+    bool AnvTree::Less(const Entry& a, const Entry& b) const
+    {
+        return std::tie(a.anv, a.address) < std::tie(b.anv, b.address);
+    }
+
+    CAmount AnvTree::Sum(NodeIdx n) const
+    {
+        return n == NIL ? 0 : m_nodes[n].sum;
+    }
+
+    void AnvTree::Pull(NodeIdx n)
+    {
+        auto& node = m_nodes[n];
+        node.sum = Sum(node.left) + node.entry.anv + Sum(node.right);
+    }
+
+    /**
+     * Splits the subtree into the entries ordered before the key and the rest.
+     * If or_equal is set, an entry equal to the key goes to the left side.
+     */
+    void AnvTree::Split(
+            NodeIdx n,
+            const Entry& key,
+            bool or_equal,
+            NodeIdx& left,
+            NodeIdx& right)
+    {
+        if (n == NIL) {
+            left = right = NIL;
+            return;
+        }
+
+        const auto& entry = m_nodes[n].entry;
+        const bool goes_left = Less(entry, key) || (or_equal && !Less(key, entry));
+
+        if (goes_left) {
+            NodeIdx right_left;
+            Split(m_nodes[n].right, key, or_equal, right_left, right);
+            m_nodes[n].right = right_left;
+            left = n;
+        } else {
+            NodeIdx left_right;
+            Split(m_nodes[n].left, key, or_equal, left, left_right);
+            m_nodes[n].left = left_right;
+            right = n;
+        }
+        Pull(n);
+    }
+
+    AnvTree::NodeIdx AnvTree::Merge(NodeIdx left, NodeIdx right)
+    {
+        if (left == NIL) return right;
+        if (right == NIL) return left;
+
+        if (m_nodes[left].priority > m_nodes[right].priority) {
+            const auto merged = Merge(m_nodes[left].right, right);
+            m_nodes[left].right = merged;
+            Pull(left);
+            return left;
+        }
+
+        const auto merged = Merge(left, m_nodes[right].left);
+        m_nodes[right].left = merged;
+        Pull(right);
+        return right;
+    }
+
+    void AnvTree::Link(const Entry& entry)
+    {
+        NodeIdx n;
+        if (m_free.empty()) {
+            n = static_cast<NodeIdx>(m_nodes.size());
+            m_nodes.emplace_back();
+        } else {
+            n = m_free.back();
+            m_free.pop_back();
+        }
+
+        m_nodes[n] = Node{entry, m_rng.rand64(), NIL, NIL, entry.anv};
+        m_index[entry.address] = n;
+        if (entry.anv < 0) {
+            m_negatives++;
+        }
+
+        NodeIdx left, right;
+        Split(m_root, entry, false, left, right);
+        m_root = Merge(Merge(left, n), right);
+    }
+
+    void AnvTree::Unlink(NodeIdx n)
+    {
+        const auto entry = m_nodes[n].entry;
+
+        NodeIdx left, middle, right;
+        Split(m_root, entry, false, left, right);
+        Split(right, entry, true, middle, right);
+        assert(middle == n);
+
+        m_root = Merge(left, right);
+
+        m_index.erase(entry.address);
+        m_free.push_back(n);
+        if (entry.anv < 0) {
+            assert(m_negatives > 0);
+            m_negatives--;
+        }
+    }
+} // namespace pog
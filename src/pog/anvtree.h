@@ -0,0 +1,100 @@
+// Copyright (c) 2017-2018 The Merit Foundation developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef MERIT_POG_ANVTREE_H
+#define MERIT_POG_ANVTREE_H
+
+#include "amount.h"
+#include "random.h"
+#include "uint256.h"
+
+#include <boost/optional.hpp>
+#include <unordered_map>
+#include <vector>
+
+namespace pog
+{
+    /**
+     * An order statistics tree of addresses sorted by (ANV, address), the same
+     * order AnvDistribution sorts its entrants in. Every node also keeps the
+     * total ANV of its subtree, so entries can be inserted, removed, re-keyed
+     * and sampled by cumulative ANV in O(log n) without rebuilding anything.
+     *
+     * One address can be excluded. It is remembered but kept out of the tree
+     * until a different address is excluded.
+     */
+    class AnvTree
+    {
+        public:
+            struct Entry
+            {
+                char address_type;
+                uint160 address;
+                CAmount anv;
+            };
+
+            void Clear();
+
+            void Insert(char address_type, const uint160& address, CAmount anv);
+            bool Erase(const uint160& address);
+            bool Update(const uint160& address, CAmount anv);
+            void Exclude(const uint160& address);
+
+            /**
+             * Returns the first entry in order whose cumulative ANV, including
+             * its own, is at least the selected amount. The selected amount
+             * must be less than Total().
+             */
+            const Entry& Select(CAmount selected) const;
+
+            CAmount Total() const;
+            size_t Size() const;
+
+            /**
+             * Number of entries with a negative ANV. Sampling is only defined
+             * when there are none.
+             */
+            size_t Negatives() const;
+
+        private:
+            using NodeIdx = int;
+            static const NodeIdx NIL = -1;
+
+            struct Node
+            {
+                Entry entry;
+                uint64_t priority;
+                NodeIdx left;
+                NodeIdx right;
+                CAmount sum;
+            };
+
+            std::vector<Node> m_nodes;
+            std::vector<NodeIdx> m_free;
+            std::unordered_map<uint160, NodeIdx> m_index;
+            NodeIdx m_root = NIL;
+            size_t m_negatives = 0;
+            FastRandomContext m_rng;
+
+            boost::optional<uint160> m_excluded;
+            boost::optional<Entry> m_excluded_entry;
+
+            bool Less(const Entry& a, const Entry& b) const;
+            CAmount Sum(NodeIdx n) const;
+            void Pull(NodeIdx n);
+
+            void Split(
+                    NodeIdx n,
+                    const Entry& key,
+                    bool or_equal,
+                    NodeIdx& left,
+                    NodeIdx& right);
+            NodeIdx Merge(NodeIdx left, NodeIdx right);
+
+            void Link(const Entry& entry);
+            void Unlink(NodeIdx n);
+    };
+} // namespace pog
+
+#endif //MERIT_POG_ANVTREE_H
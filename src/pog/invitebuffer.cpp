@@ -3,6 +3,7 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "pog/invitebuffer.h"
+#include "txdb.h"
 #include "validation.h"
 
 #include <vector>
@@ -11,13 +12,15 @@ namespace pog
 {
     InviteBuffer::InviteBuffer(const CChain& c) : chain{c} {}
 
-    bool ComputeStats(
+    void ComputeStats(
             int height,
             const CBlock& block,
+            const std::vector<CTxUndo>& invites_undo,
             InviteStats& stats,
             const Consensus::Params& params)
     {
         assert(height >= 0);
+        assert(invites_undo.size() == block.invites.size());
 
         bool check_for_beacon = height >= params.imp_invites_blockheight;
 
@@ -28,29 +31,19 @@ namespace pog
             }
         }
 
-        for (const auto& invite : block.invites) {
+        for (size_t i = 0; i < block.invites.size(); i++) {
+            const auto& invite = block.invites[i];
             if (!invite->IsCoinBase()) {
+                const auto& spent = invites_undo[i].vprevout;
+                assert(spent.size() == invite->vin.size());
 
                 int coinbase_used = 0;
-                for (const auto& in : invite->vin) {
-                    CTransactionRef prev;
-                    uint256 block_inv_is_in;
-
-                    if (!GetTransaction(
-                                in.prevout.hash,
-                                prev,
-                                params,
-                                block_inv_is_in,
-                                false)) {
-                        return false;
-                    }
-
-                    assert(prev);
-                    if (!prev->IsCoinBase()) {
+                for (const auto& coin : spent) {
+                    if (!coin.IsCoinBase()) {
                         continue;
                     }
 
-                    coinbase_used += prev->vout.at(in.prevout.n).nValue;
+                    coinbase_used += coin.out.nValue;
                 }
 
                 if (check_for_beacon) {
@@ -75,6 +68,44 @@ namespace pog
                 }
             }
         }
+    }
+
+    /**
+     * Looks up the coins spent by the invites of a block from the
+     * transaction index. Only needed for blocks connected before their
+     * stats were stored.
+     */
+    bool ReadSpentInvites(
+            const CBlock& block,
+            const Consensus::Params& params,
+            std::vector<CTxUndo>& invites_undo)
+    {
+        invites_undo.resize(block.invites.size());
+
+        for (size_t i = 0; i < block.invites.size(); i++) {
+            const auto& invite = block.invites[i];
+            if (invite->IsCoinBase()) {
+                continue;
+            }
+
+            for (const auto& in : invite->vin) {
+                CTransactionRef prev;
+                uint256 block_inv_is_in;
+
+                if (!GetTransaction(
+                            in.prevout.hash,
+                            prev,
+                            params,
+                            block_inv_is_in,
+                            false)) {
+                    return false;
+                }
+
+                assert(prev);
+                invites_undo[i].vprevout.emplace_back(
+                        prev->vout.at(in.prevout.n), 0, prev->IsCoinBase(), prev->IsInvite());
+            }
+        }
 
         return true;
     }
@@ -103,15 +134,26 @@ namespace pog
             return s;
         }
 
+        InviteStats stored;
+        if (pblocktree->ReadInviteStats(index->GetBlockHash(), stored)) {
+            stored.is_set = true;
+            insert(adjusted_height, stored);
+            return stored;
+        }
+
         CBlock block;
         if (!ReadBlockFromDisk(block, index, params, false)) {
             return s;
         }
 
-        if (!ComputeStats(height, block, s, params)) {
+        std::vector<CTxUndo> invites_undo;
+        if (!ReadSpentInvites(block, params, invites_undo)) {
             return s;
         }
 
+        ComputeStats(height, block, invites_undo, s, params);
+        unsaved.emplace_back(index->GetBlockHash(), s);
+
         s.is_set = true;
         insert(adjusted_height, s);
         return s;
@@ -146,6 +188,26 @@ namespace pog
         return true;
     }
 
+    bool InviteBuffer::flush()
+    {
+        // get() may take cs_main while holding cs, so write without cs.
+        std::vector<std::pair<uint256, InviteStats>> to_write;
+        {
+            LOCK(cs);
+            to_write.swap(unsaved);
+        }
+
+        for (const auto& block_stats : to_write) {
+            if (!pblocktree->WriteInviteStats(block_stats.first, block_stats.second)) {
+                LogPrintf("%s: failed to store invite stats of block %s\n",
+                        __func__, block_stats.first.GetHex());
+                return false;
+            }
+        }
+
+        return true;
+    }
+
     bool InviteBuffer::get(int adjusted_height, InviteStats& s) const
     {
         if(stats.size() <= adjusted_height) {
@@ -7,7 +7,10 @@
 
 #include "pog/reward.h"
 #include "chain.h"
+#include "coins.h"
+#include "serialize.h"
 #include "sync.h"
+#include "undo.h"
 
 #include <vector>
 
@@ -40,8 +43,30 @@ namespace pog
         int invites_used = 0;
         bool is_set = false;
         bool mean_set = false;
+
+        // Only the counts of the block itself are stored.
+        ADD_SERIALIZE_METHODS;
+
+        template <typename Stream, typename Operation>
+        inline void SerializationOp(Stream& s, Operation ser_action)
+        {
+            READWRITE(invites_created);
+            READWRITE(invites_used);
+        }
     };
 
+    /**
+     * Counts the invites created and used by a block. invites_undo holds
+     * the coins spent by every invite of the block, in block order, like
+     * the undo data ConnectBlock builds.
+     */
+    void ComputeStats(
+            int height,
+            const CBlock& block,
+            const std::vector<CTxUndo>& invites_undo,
+            InviteStats& stats,
+            const Consensus::Params& params);
+
     class InviteBuffer
     {
         public:
@@ -51,12 +76,20 @@ namespace pog
 
             bool drop(int height, const Consensus::Params& p);
 
+            /**
+             * Stores the stats that get() computed for blocks connected
+             * before stats were kept in the block tree DB. Called when the
+             * block index is flushed so lookups never write to the DB.
+             */
+            bool flush();
+
         private:
             bool get(int adjusted_height, InviteStats& s) const;
             void insert(int adjusted_height, const InviteStats& s) const;
 
         private:
             mutable std::vector<InviteStats> stats;
+            mutable std::vector<std::pair<uint256, InviteStats>> unsaved;
             mutable CCriticalSection cs;
             const CChain& chain;
     };
@@ -241,13 +241,31 @@ namespace pog
         assert(m_max_anv >= 0);
     }
 
-    const referral::AddressANV& AnvDistribution::Sample(const uint256& hash) const
+    /**
+     * The tree is already sorted the same way as the new sort above and keeps
+     * the cumulative ANVs in its nodes, so there is nothing to build. This
+     * must only be used for blocks at or after 16000.
+     */
+    AnvDistribution::AnvDistribution(const AnvTree& tree) :
+        m_max_anv{tree.Total()},
+        m_tree{&tree}
+    {
+        assert(tree.Negatives() == 0);
+        assert(m_max_anv >= 0);
+    }
+
+    referral::AddressANV AnvDistribution::Sample(const uint256& hash) const
     {
         //It doesn't make sense to sample from an empty distribution.
-        assert(m_inverted.empty() == false);
+        assert(Size() > 0);
 
         const auto selected_anv = SipHashUint256(0, 0, hash) % m_max_anv;
 
+        if (m_tree) {
+            const auto& selected = m_tree->Select(selected_anv);
+            return {selected.address_type, selected.address, selected.anv};
+        }
+
         auto pos = std::lower_bound(std::begin(m_inverted), std::end(m_inverted),
                 selected_anv,
                 [](const referral::AddressANV& a, CAmount selected) {
@@ -266,12 +284,15 @@ namespace pog
     }
 
     size_t AnvDistribution::Size() const {
-        return m_inverted.size();
+        return m_tree ? m_tree->Size() : m_inverted.size();
     }
 
     WalletSelector::WalletSelector(int height, const referral::AddressANVs& anvs) :
         m_distribution{height, anvs} {}
 
+    WalletSelector::WalletSelector(const AnvTree& tree) :
+        m_distribution{tree} {}
+
     /**
      * Selecting winners from the distribution is deterministic and will return the same
      * N samples given the same input hash.
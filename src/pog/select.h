@@ -8,6 +8,7 @@
 #include "hash.h"
 #include "amount.h"
 #include "pog/anv.h"
+#include "pog/anvtree.h"
 #include <boost/multiprecision/cpp_dec_float.hpp>
 
 #include <map>
@@ -26,19 +27,24 @@ namespace pog
     {
         public:
             AnvDistribution(int height, referral::AddressANVs anvs);
-            const referral::AddressANV& Sample(const uint256& hash) const;
+            explicit AnvDistribution(const AnvTree& tree);
+            referral::AddressANV Sample(const uint256& hash) const;
             size_t Size() const;
 
         private:
             InvertedAnvs m_inverted;
             WalletToAnv m_anvs;
             CAmount m_max_anv = 0;
+
+            //Set when sampling straight from an already sorted tree.
+            const AnvTree* m_tree = nullptr;
     };
 
     class WalletSelector
     {
         public:
             WalletSelector(int height, const referral::AddressANVs& anvs);
+            explicit WalletSelector(const AnvTree& tree);
 
             referral::AddressANVs Select(
                     bool check_confirmations,
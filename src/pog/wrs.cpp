@@ -11,51 +11,92 @@
 namespace pog
 {
     const double LOG_MAX_UINT64 = std::log(std::numeric_limits<uint64_t>::max());
+    const double ESTIMATE_MARGIN = 1e-9;
 
-    /* 
+    /*
      * We need to compute a weighted key for each entrant in the lottery.
-     * Int the RES algorithm by Efraimidis and Spirakis the weighted key is 
-     * computed by rand^(1/W). Where rand is a uniform random value between 
-     * [0,1] and W is a weight. 
+     * Int the RES algorithm by Efraimidis and Spirakis the weighted key is
+     * computed by rand^(1/W). Where rand is a uniform random value between
+     * [0,1] and W is a weight.
      *
      * The weight in our case is the ANV of the address.
      *
      * Instead of computing the power above we will take the log as the weighted
      * key instead. log(rand^(1/W)) = log(rand) / W.
-     */ 
-    WeightedKey WeightedKeyForSampling(
+     *
+     * Returns false if the key is the smallest one, -log(max_uint64_t).
+     */
+    static bool LogRandForSampling(
             const uint256& rand_value,
-            CAmount anv)
+            CAmount anv,
+            double& log_rand)
     {
-        if(anv == 0) { 
-            return -LOG_MAX_UINT64;
+        if(anv == 0) {
+            return false;
         }
 
         const auto rand_uint64 = SipHashUint256(0, 0, rand_value);
 
         if(rand_uint64 == 0) {
-            return -LOG_MAX_UINT64;
+            return false;
         }
 
         /*
-         * We can think of rand_uint64 as a random value between [0,1] if we take 
-         * rand_uint64 and divide it the max uint64_t. 
+         * We can think of rand_uint64 as a random value between [0,1] if we take
+         * rand_uint64 and divide it the max uint64_t.
          *
          * rand = rand_uint64/max_uint64_t
          *
-         * log(rand) = log(rand_uint64/max_uint64_t) 
+         * log(rand) = log(rand_uint64/max_uint64_t)
          *           = log(rand_uint64) - log(max_uint64_t)
          */
-        const BigFloat log_rand = 
-            std::log(rand_uint64) - LOG_MAX_UINT64;
+        log_rand = std::log(rand_uint64) - LOG_MAX_UINT64;
 
         //We should get a negative number here.
         assert(log_rand <= 0);
+        return true;
+    }
+
+    WeightedKey WeightedKeyForSampling(
+            const uint256& rand_value,
+            CAmount anv)
+    {
+        double log_rand;
+        if(!LogRandForSampling(rand_value, anv, log_rand)) {
+            return -LOG_MAX_UINT64;
+        }
 
+        const BigFloat log_rand_f = log_rand;
         const BigFloat anv_f = anv;
-        const WeightedKey weighted_key = log_rand / anv_f;
+        const WeightedKey weighted_key = log_rand_f / anv_f;
 
         return weighted_key;
     }
 
+    double WeightedKeyEstimate(
+            const uint256& rand_value,
+            CAmount anv)
+    {
+        double log_rand;
+        if(!LogRandForSampling(rand_value, anv, log_rand)) {
+            return -LOG_MAX_UINT64;
+        }
+
+        return log_rand / static_cast<double>(anv);
+    }
+
+    /*
+     * Keys are never positive so the greater key is the one closer to zero.
+     *
+     * The estimate is log_rand divided by the ANV rounded to a double, so it
+     * is within 2^-51 of the exact quotient and the big float key is within
+     * 10^-50 of it. bound is within 2^-52 of the key it stands for. An
+     * estimate further from zero than bound by more than the margin
+     * therefore belongs to a key that is smaller than the bound's key.
+     */
+    bool KeyEstimateCannotExceed(double estimate, double bound)
+    {
+        return std::fabs(estimate) > std::fabs(bound) * (1 + ESTIMATE_MARGIN);
+    }
+
 } //namespace pog
@@ -17,6 +17,21 @@ namespace pog
     using WeightedKey = BigFloat;
 
     WeightedKey WeightedKeyForSampling( const uint256& rand_value, CAmount anv);
+
+    /**
+     * WeightedKeyForSampling in double precision, within a relative error of
+     * 2^-50 of the exact key and a lot cheaper to compute.
+     */
+    double WeightedKeyEstimate(const uint256& rand_value, CAmount anv);
+
+    /**
+     * True if a key estimated by WeightedKeyEstimate is certainly not greater
+     * than a key whose value in double precision is bound. The margin is many
+     * times the error of both doubles and of the big float division, so this
+     * never disagrees with comparing the exact keys. False means the exact
+     * keys have to be compared.
+     */
+    bool KeyEstimateCannotExceed(double estimate, double bound);
 } // namespace pog
 
 #endif //MERIT_POG_WRS_H
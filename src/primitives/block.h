@@ -7,6 +7,7 @@
 #ifndef MERIT_PRIMITIVES_BLOCK_H
 #define MERIT_PRIMITIVES_BLOCK_H
 
+#include "cuckoo/cycle.h"
 #include "primitives/transaction.h"
 #include "primitives/referral.h"
 #include "serialize.h"
@@ -35,7 +36,7 @@ public:
     uint32_t nBits;
     uint32_t nNonce;
     uint8_t nEdgeBits;
-    std::set<uint32_t> sCycle;
+    cuckoo::Cycle sCycle;
 
     CBlockHeader()
     {
@@ -5,7 +5,10 @@
 #include "refdb.h"
 
 #include "base58.h"
+#include "memusage.h"
+#include "streams.h"
 #include <boost/rational.hpp>
+#include <algorithm>
 #include <limits>
 
 namespace pog
@@ -25,13 +28,59 @@ namespace referral
         const char DB_PUBKEY = 'k';
         const char DB_LOT_SIZE = 's';
         const char DB_LOT_VAL = 'v';
+        const char DB_LOT_POS = 'o';
+        const char DB_LOT_INDEXED = 'x';
         const char DB_CONFIRMATION = 'i';
         const char DB_CONFIRMATION_IDX = 'n';
         const char DB_CONFIRMATION_TOTAL = 'u';
         const char DB_PRE_DAEDALUS_CONFIRMED = 'd';
         const char DB_ALIAS = 'l';
+        const char DB_BEST_BLOCK = 'B';
+        const char DB_CHILDREN_KEYED = 'y';
 
         const size_t MAX_LEVELS = std::numeric_limits<size_t>::max();
+
+        /**
+         * Already serialized bytes that are written to a stream as is, used to
+         * move pending keys and values in and out of the DB untouched.
+         */
+        struct RawBytes
+        {
+            std::string bytes;
+
+            template <typename Stream>
+            void Serialize(Stream& s) const
+            {
+                s.write(bytes.data(), bytes.size());
+            }
+
+            template <typename Stream>
+            void Unserialize(Stream& s)
+            {
+                bytes.assign(s.begin(), s.end());
+                s.ignore(s.size());
+            }
+        };
+
+        template <typename T>
+        std::string ToBytes(const T& obj)
+        {
+            CDataStream ss{SER_DISK, CLIENT_VERSION};
+            ss << obj;
+            return std::string{ss.begin(), ss.end()};
+        }
+
+        template <typename T>
+        bool FromBytes(const std::string& bytes, T& obj)
+        {
+            try {
+                CDataStream ss{bytes.data(), bytes.data() + bytes.size(), SER_DISK, CLIENT_VERSION};
+                ss >> obj;
+            } catch (const std::exception&) {
+                return false;
+            }
+            return true;
+        }
     }
 
     //stores ANV internally as a rational number with numerator/denominator
@@ -40,6 +89,28 @@ namespace referral
     using AnvRat = boost::rational<CAmount>;
     using TransactionOutIndex = int;
     using ConfirmationVal = std::pair<char, Address>;
+    using ChildKey = std::pair<char, std::pair<Address, Address>>;
+
+    CAmount AnvInToAnvPub(const AnvInternal& in)
+    {
+        AnvRat anv_rat{in.first, in.second};
+        return boost::rational_cast<CAmount>(anv_rat);
+    }
+
+    /**
+     * Adds a change to a stored ANV. The rationals are not checked for
+     * overflow, so UpdateANV and UpdateANVs must both go through here to
+     * wrap the same way on huge ANVs.
+     */
+    void AddToAnvIn(AnvInternal& anv_in, const AnvRat& change)
+    {
+        AnvRat anv_rat{anv_in.first, anv_in.second};
+
+        anv_rat += change;
+
+        anv_in.first = anv_rat.numerator();
+        anv_in.second = anv_rat.denominator();
+    }
 
     namespace {
         class ReferralIdVisitor : public boost::static_visitor<MaybeReferral>
@@ -72,10 +143,243 @@ namespace referral
             bool wipe,
             const std::string& db_name) : m_db(GetDataDir() / db_name, cache_size, memory, wipe, true) {}
 
+    template <typename K, typename V>
+    bool ReferralsViewDB::ReadEntry(const K& key, V& value) const
+    {
+        LOCK(m_cs);
+        m_reads++;
+        if (!m_pending.empty()) {
+            const auto it = m_pending.find(ToBytes(key));
+            if (it != m_pending.end()) {
+                return it->second && FromBytes(*it->second, value);
+            }
+        }
+
+        m_disk_reads++;
+        return m_db.Read(key, value);
+    }
+
+    template <typename K>
+    bool ReferralsViewDB::HasEntry(const K& key) const
+    {
+        LOCK(m_cs);
+        m_reads++;
+        if (!m_pending.empty()) {
+            const auto it = m_pending.find(ToBytes(key));
+            if (it != m_pending.end()) {
+                return static_cast<bool>(it->second);
+            }
+        }
+
+        m_disk_reads++;
+        return m_db.Exists(key);
+    }
+
+    template <typename K, typename V>
+    bool ReferralsViewDB::WriteEntry(const K& key, const V& value) const
+    {
+        StageEntry(ToBytes(key), ToBytes(value));
+        return true;
+    }
+
+    template <typename K>
+    bool ReferralsViewDB::EraseEntry(const K& key) const
+    {
+        StageEntry(ToBytes(key), RawValue{});
+        return true;
+    }
+
+    void ReferralsViewDB::StageEntry(std::string key, RawValue value) const
+    {
+        LOCK(m_cs);
+        m_writes++;
+        auto it = m_pending.find(key);
+        if (it == m_pending.end()) {
+            m_pending_usage += key.size();
+            it = m_pending.emplace(std::move(key), RawValue{}).first;
+        } else if (it->second) {
+            m_pending_usage -= it->second->size();
+        }
+
+        if (value) {
+            m_pending_usage += value->size();
+        }
+        it->second = std::move(value);
+    }
+
+    /**
+     * Visits every entry whose key starts with the prefix in key order, from
+     * the first key not before start. Pending writes shadow what is on disk
+     * and pending erases hide it. Stops early and returns false if the
+     * visitor does.
+     */
+    bool ReferralsViewDB::ForEachEntry(
+            const std::string& prefix,
+            const EntryVisitor& visit,
+            const std::string& start) const
+    {
+        LOCK(m_cs);
+        const auto has_prefix = [&prefix](const std::string& key) {
+            return key.compare(0, prefix.size(), prefix) == 0;
+        };
+
+        auto pending = m_pending.lower_bound(std::max(prefix, start));
+        bool pending_valid = pending != m_pending.end() && has_prefix(pending->first);
+
+        std::unique_ptr<CDBIterator> iter{m_db.NewIterator()};
+        iter->SeekPrefix(RawBytes{prefix}, RawBytes{start});
+
+        RawBytes key;
+        RawBytes value;
+        bool db_valid = iter->Valid() && iter->GetKey(key);
+
+        while (db_valid || pending_valid) {
+            if (pending_valid && (!db_valid || pending->first <= key.bytes)) {
+                if (db_valid && pending->first == key.bytes) {
+                    iter->Next();
+                    db_valid = iter->Valid() && iter->GetKey(key);
+                }
+
+                if (pending->second && !visit(pending->first, *pending->second)) {
+                    return false;
+                }
+
+                ++pending;
+                pending_valid = pending != m_pending.end() && has_prefix(pending->first);
+            } else {
+                if (iter->GetValue(value) && !visit(key.bytes, value.bytes)) {
+                    return false;
+                }
+
+                iter->Next();
+                db_valid = iter->Valid() && iter->GetKey(key);
+            }
+        }
+
+        return true;
+    }
+
+    bool ReferralsViewDB::Flush(const uint256& best_block)
+    {
+        LOCK(m_cs);
+        CDBBatch batch{m_db};
+        for (const auto& entry : m_pending) {
+            if (entry.second) {
+                batch.Write(RawBytes{entry.first}, RawBytes{*entry.second});
+            } else {
+                batch.Erase(RawBytes{entry.first});
+            }
+        }
+        batch.Write(DB_BEST_BLOCK, best_block);
+
+        LogPrint(BCLog::DB, "Writing %u referral db changes (%.1f KiB) at %s\n",
+                m_pending.size(),
+                batch.SizeEstimate() / 1024.0,
+                best_block.GetHex());
+
+        if (!m_db.WriteBatch(batch)) {
+            return false;
+        }
+
+        m_pending.clear();
+        m_pending_usage = 0;
+        return true;
+    }
+
+    uint256 ReferralsViewDB::GetBestBlock() const
+    {
+        uint256 best_block;
+        if (!m_db.Read(DB_BEST_BLOCK, best_block)) {
+            return uint256{};
+        }
+        return best_block;
+    }
+
+    size_t ReferralsViewDB::DynamicMemoryUsage() const
+    {
+        LOCK(m_cs);
+        return memusage::DynamicUsage(m_pending) + m_pending_usage;
+    }
+
+    ReferralsDBStats ReferralsViewDB::GetStats() const
+    {
+        ReferralsDBStats stats;
+        stats.reads = m_reads;
+        stats.disk_reads = m_disk_reads;
+        stats.writes = m_writes;
+        return stats;
+    }
+
+    /**
+     * Currently implemented: from one vector of children per parent, keyed by
+     * 'c' + parent, to one entry per child keyed by 'c' + parent + child.
+     */
+    bool ReferralsViewDB::Upgrade()
+    {
+        LOCK(m_cs);
+        assert(m_pending.empty());
+
+        if (m_db.Exists(DB_CHILDREN_KEYED)) {
+            return true;
+        }
+
+        LogPrintf("Upgrading referral children index...\n");
+
+        const auto old_key_size = ToBytes(std::make_pair(DB_CHILDREN, Address{})).size();
+        const size_t batch_size = 1 << 24;
+
+        std::unique_ptr<CDBIterator> iter{m_db.NewIterator()};
+        iter->SeekPrefix(DB_CHILDREN);
+
+        CDBBatch batch{m_db};
+        size_t parents = 0;
+        size_t children = 0;
+
+        for (; iter->Valid(); iter->Next()) {
+            RawBytes raw_key;
+            if (!iter->GetKey(raw_key)) {
+                break;
+            }
+
+            if (raw_key.bytes.size() != old_key_size) {
+                continue;
+            }
+
+            std::pair<char, Address> key;
+            ChildAddresses addresses;
+            if (!FromBytes(raw_key.bytes, key) || !iter->GetValue(addresses)) {
+                return error("%s: cannot parse children record", __func__);
+            }
+
+            for (const auto& child : addresses) {
+                batch.Write(ChildKey{DB_CHILDREN, {key.second, child}}, true);
+            }
+            batch.Erase(key);
+
+            parents++;
+            children += addresses.size();
+
+            if (batch.SizeEstimate() > batch_size) {
+                if (!m_db.WriteBatch(batch)) {
+                    return false;
+                }
+                batch.Clear();
+            }
+        }
+
+        batch.Write(DB_CHILDREN_KEYED, true);
+        if (!m_db.WriteBatch(batch)) {
+            return false;
+        }
+
+        LogPrintf("Moved %u children of %u referrals to their own keys\n", children, parents);
+        return true;
+    }
+
     MaybeReferral ReferralsViewDB::GetReferral(const Address& address) const
     {
         MutableReferral referral;
-        return m_db.Read(std::make_pair(DB_REFERRALS, address), referral) ?
+        return ReadEntry(std::make_pair(DB_REFERRALS, address), referral) ?
             MaybeReferral{referral} :
             MaybeReferral{};
     }
@@ -83,7 +387,7 @@ namespace referral
     MaybeReferral ReferralsViewDB::GetReferral(const uint256& hash) const
     {
         Address address;
-        if (m_db.Read(std::make_pair(DB_HASH, hash), address)) {
+        if (ReadEntry(std::make_pair(DB_HASH, hash), address)) {
             return GetReferral(address);
         }
 
@@ -105,7 +409,7 @@ namespace referral
         }
 
         Address address;
-        if (m_db.Read(std::make_pair(DB_ALIAS, maybe_normalized), address)) {
+        if (ReadEntry(std::make_pair(DB_ALIAS, maybe_normalized), address)) {
             return IsConfirmed(address) ? GetReferral(address) : MaybeReferral{};
         }
 
@@ -125,13 +429,13 @@ namespace referral
     MaybeAddress ReferralsViewDB::GetAddressByPubKey(const CPubKey& pubkey) const
     {
         Address address;
-        return m_db.Read(std::make_pair(DB_PUBKEY, pubkey), address) ? MaybeAddress{address} : MaybeAddress{};
+        return ReadEntry(std::make_pair(DB_PUBKEY, pubkey), address) ? MaybeAddress{address} : MaybeAddress{};
     }
 
     MaybeAddressPair ReferralsViewDB::GetParentAddress(const Address& address) const
     {
         AddressPair parent;
-        return m_db.Read(std::make_pair(DB_PARENT_ADDRESS, address), parent) ?
+        return ReadEntry(std::make_pair(DB_PARENT_ADDRESS, address), parent) ?
             MaybeAddressPair{parent} :
             MaybeAddressPair{};
     }
@@ -139,7 +443,14 @@ namespace referral
     ChildAddresses ReferralsViewDB::GetChildren(const Address& address) const
     {
         ChildAddresses children;
-        m_db.Read(std::make_pair(DB_CHILDREN, address), children);
+        ForEachEntry(ToBytes(std::make_pair(DB_CHILDREN, address)),
+                [&children](const std::string& key, const std::string&) {
+                    ChildKey child_key;
+                    if (FromBytes(key, child_key)) {
+                        children.push_back(child_key.second.second);
+                    }
+                    return true;
+                });
         return children;
     }
 
@@ -148,6 +459,7 @@ namespace referral
             bool allow_no_parent,
             bool normalize_alias)
     {
+        LOCK(m_cs);
         debug("Inserting referral %s parent %s",
                 CMeritAddress{referral.addressType, referral.GetAddress()}.ToString(),
                 referral.parentAddress.GetHex());
@@ -161,21 +473,22 @@ namespace referral
         }
 
         //write referral by code hash
-        if (!m_db.Write(std::make_pair(DB_REFERRALS, referral.GetAddress()), referral)) {
+        if (!WriteEntry(std::make_pair(DB_REFERRALS, referral.GetAddress()), referral)) {
             return false;
         }
 
         ANVTuple anv{referral.addressType, referral.GetAddress(), AnvInternal{0, 1}};
-        if (!m_db.Write(std::make_pair(DB_ANV, referral.GetAddress()), anv)) {
+        if (!WriteEntry(std::make_pair(DB_ANV, referral.GetAddress()), anv)) {
             return false;
         }
+        UpdateLotteryANV(referral.GetAddress(), 0);
 
         // write referral address by hash
-        if (!m_db.Write(std::make_pair(DB_HASH, referral.GetHash()), referral.GetAddress()))
+        if (!WriteEntry(std::make_pair(DB_HASH, referral.GetHash()), referral.GetAddress()))
             return false;
 
         // write referral address by pubkey
-        if (!m_db.Write(std::make_pair(DB_PUBKEY, referral.pubkey), referral.GetAddress()))
+        if (!WriteEntry(std::make_pair(DB_PUBKEY, referral.pubkey), referral.GetAddress()))
             return false;
 
         if (referral.version >= Referral::INVITE_VERSION && referral.alias.size() > 0) {
@@ -185,7 +498,7 @@ namespace referral
                 NormalizeAlias(maybe_normalized);
             }
 
-            if (!m_db.Write(std::make_pair(DB_ALIAS, maybe_normalized), referral.GetAddress())) {
+            if (!WriteEntry(std::make_pair(DB_ALIAS, maybe_normalized), referral.GetAddress())) {
                 return false;
             }
         }
@@ -200,17 +513,13 @@ namespace referral
 
             const auto parent_address = parent_referral->GetAddress();
             AddressPair parent_addr_pair{parent_referral->addressType, parent_address};
-            if (!m_db.Write(std::make_pair(DB_PARENT_ADDRESS, referral.GetAddress()), parent_addr_pair))
+            if (!WriteEntry(std::make_pair(DB_PARENT_ADDRESS, referral.GetAddress()), parent_addr_pair))
                 return false;
 
-            // Now we update the children of the parent address by inserting into the
-            // child address array for the parent.
-            ChildAddresses children;
-            m_db.Read(std::make_pair(DB_CHILDREN, referral.parentAddress), children);
-
-            children.push_back(referral.GetAddress());
-
-            if (!m_db.Write(std::make_pair(DB_CHILDREN, referral.parentAddress), children))
+            // Now we add the address to the children of the parent address.
+            // Every child has its own key so this does not depend on how many
+            // children the parent already has.
+            if (!WriteEntry(ChildKey{DB_CHILDREN, {referral.parentAddress, referral.GetAddress()}}, true))
                 return false;
 
             debug("Inserted referral %s parent %s",
@@ -233,30 +542,23 @@ namespace referral
     {
         debug("Removing Referral %d", CMeritAddress{referral.addressType, referral.GetAddress()}.ToString());
 
-        if (!m_db.Erase(std::make_pair(DB_REFERRALS, referral.GetAddress()))) {
+        if (!EraseEntry(std::make_pair(DB_REFERRALS, referral.GetAddress()))) {
             return false;
         }
 
-        if (!m_db.Erase(std::make_pair(DB_HASH, referral.GetHash()))) {
+        if (!EraseEntry(std::make_pair(DB_HASH, referral.GetHash()))) {
             return false;
         }
 
-        if (!m_db.Erase(std::make_pair(DB_PUBKEY, referral.pubkey))) {
+        if (!EraseEntry(std::make_pair(DB_PUBKEY, referral.pubkey))) {
             return false;
         }
 
-        if (!m_db.Erase(std::make_pair(DB_PARENT_ADDRESS, referral.GetAddress()))) {
+        if (!EraseEntry(std::make_pair(DB_PARENT_ADDRESS, referral.GetAddress()))) {
             return false;
         }
 
-        ChildAddresses children;
-        m_db.Read(std::make_pair(DB_CHILDREN, referral.parentAddress), children);
-
-        children.erase(std::remove(std::begin(children), std::end(children),
-                    referral.GetAddress()),
-                std::end(children));
-
-        if (!m_db.Write(std::make_pair(DB_CHILDREN, referral.parentAddress), children)) {
+        if (!EraseEntry(ChildKey{DB_CHILDREN, {referral.parentAddress, referral.GetAddress()}})) {
             return false;
         }
 
@@ -278,6 +580,7 @@ namespace referral
             const Address& start_address,
             CAmount change)
     {
+        LOCK(m_cs);
         AnvRat change_rat = change;
 
         debug("\tUpdateANV: %s + %d",
@@ -290,7 +593,7 @@ namespace referral
         while (address && change != 0 && level < MAX_LEVELS) {
             //it's possible address didn't exist yet so an ANV of 0 is assumed.
             ANVTuple anv;
-            if (!m_db.Read(std::make_pair(DB_ANV, *address), anv)) {
+            if (!ReadEntry(std::make_pair(DB_ANV, *address), anv)) {
                 debug("\tFailed to read ANV for %s", address->GetHex());
                 return false;
             }
@@ -307,20 +610,15 @@ namespace referral
                     change);
 
             auto& anv_in = std::get<2>(anv);
+            AddToAnvIn(anv_in, change_rat);
 
-            AnvRat anv_rat{anv_in.first, anv_in.second};
-
-            anv_rat += change_rat;
-
-            anv_in.first = anv_rat.numerator();
-            anv_in.second = anv_rat.denominator();
-
-            if (!m_db.Write(std::make_pair(DB_ANV, *address), anv)) {
+            if (!WriteEntry(std::make_pair(DB_ANV, *address), anv)) {
                 //TODO: Do we rollback anv computation for already processed address?
                 // likely if we can't write then rollback will fail too.
                 // figure out how to mark database as corrupt.
                 return false;
             }
+            UpdateLotteryANV(*address, AnvInToAnvPub(anv_in));
 
             const auto parent = GetParentAddress(*address);
             if (parent) {
@@ -339,16 +637,104 @@ namespace referral
         return true;
     }
 
-    CAmount AnvInToAnvPub(const AnvInternal& in)
+    namespace
     {
-        AnvRat anv_rat{in.first, in.second};
-        return boost::rational_cast<CAmount>(anv_rat);
+        /**
+         * An ANV touched by a batch of ANV changes along with its parent, both
+         * read from the DB once per batch.
+         */
+        struct ANVNode
+        {
+            ANVTuple anv;
+            MaybeAddress parent;
+        };
+
+        using ANVNodes = std::unordered_map<Address, ANVNode>;
+    }
+
+    /**
+     * Applies the changes in order exactly as UpdateANV does, adding the same
+     * halved change to every ancestor in turn, but against copies of the ANVs
+     * held in memory. Each ANV and parent is read once and each ANV written
+     * once, however many changes reach it. The rationals are not checked for
+     * overflow and regrouping the additions could change how huge ANVs
+     * wrap, so every ANV sees the same additions in the same order as with
+     * UpdateANV and ends up with the same value.
+     */
+    bool ReferralsViewDB::UpdateANVs(const ANVChanges& changes)
+    {
+        LOCK(m_cs);
+        ANVNodes nodes;
+
+        for (const auto& c : changes) {
+            const auto& start_address = std::get<1>(c);
+            const auto change = std::get<2>(c);
+
+            if (change == 0) {
+                continue;
+            }
+
+            debug("\tUpdateANVs: %s + %d",
+                    CMeritAddress(std::get<0>(c), start_address).ToString(), change);
+
+            AnvRat change_rat = change;
+            MaybeAddress address = start_address;
+            size_t level = 0;
+
+            //MAX_LEVELS guards against cycles in DB
+            while (address && level < MAX_LEVELS) {
+                auto it = nodes.find(*address);
+                if (it == nodes.end()) {
+                    ANVNode node;
+                    if (!ReadEntry(std::make_pair(DB_ANV, *address), node.anv)) {
+                        debug("\tFailed to read ANV for %s", address->GetHex());
+                        return false;
+                    }
+
+                    assert(std::get<0>(node.anv) != 0);
+                    assert(!std::get<1>(node.anv).IsNull());
+
+                    if (const auto parent = GetParentAddress(*address)) {
+                        node.parent = parent->second;
+                    }
+
+                    it = nodes.emplace(*address, std::move(node)).first;
+                }
+
+                AddToAnvIn(std::get<2>(it->second.anv), change_rat);
+
+                address = it->second.parent;
+                level++;
+                change_rat /= 2;
+            }
+
+            // We should never have cycles in the DB.
+            // Hacked? Bug?
+            assert(level < MAX_LEVELS && "reached max levels. Referral DB cycle detected");
+        }
+
+        for (const auto& entry : nodes) {
+            const auto& anv = entry.second.anv;
+            const auto& anv_in = std::get<2>(anv);
+
+            debug("\t\t %s %d/%d",
+                    CMeritAddress(std::get<0>(anv), std::get<1>(anv)).ToString(),
+                    anv_in.first,
+                    anv_in.second);
+
+            if (!WriteEntry(std::make_pair(DB_ANV, entry.first), anv)) {
+                return false;
+            }
+            UpdateLotteryANV(entry.first, AnvInToAnvPub(anv_in));
+        }
+
+        return true;
     }
 
     MaybeAddressANV ReferralsViewDB::GetANV(const Address& address) const
     {
         ANVTuple anv;
-        if (!m_db.Read(std::make_pair(DB_ANV, address), anv)) {
+        if (!ReadEntry(std::make_pair(DB_ANV, address), anv)) {
             return MaybeAddressANV{};
         }
 
@@ -360,39 +746,62 @@ namespace referral
                 });
     }
 
+    namespace {
+        bool ANVFromBytes(const std::string& value, AddressANV& address_anv)
+        {
+            ANVTuple anv;
+            if (!FromBytes(value, anv)) {
+                return false;
+            }
+
+            address_anv = {std::get<0>(anv),
+                std::get<1>(anv),
+                AnvInToAnvPub(std::get<2>(anv))};
+            return true;
+        }
+    }
+
     AddressANVs ReferralsViewDB::GetAllANVs() const
     {
-        std::unique_ptr<CDBIterator> iter{m_db.NewIterator()};
-        iter->SeekToFirst();
-
         AddressANVs anvs;
-        auto address = std::make_pair(DB_ANV, Address{});
-        while (iter->Valid()) {
-            //filter non ANV addresss
-            if (!iter->GetKey(address)) {
-                iter->Next();
-                continue;
+        ForEachEntry(ToBytes(DB_ANV), [&anvs](const std::string&, const std::string& value) {
+            AddressANV anv;
+            if (ANVFromBytes(value, anv)) {
+                anvs.push_back(anv);
             }
+            return true;
+        });
+        return anvs;
+    }
 
-            if (address.first != DB_ANV) {
-                iter->Next();
-                continue;
-            }
+    bool ReferralsViewDB::GetANVsAfter(
+            const MaybeAddress& after,
+            size_t max_count,
+            AddressANVs& anvs) const
+    {
+        const auto start = after ? ToBytes(std::make_pair(DB_ANV, *after)) : std::string{};
 
-            ANVTuple anv;
-            if (!iter->GetValue(anv)) {
-                iter->Next();
-                continue;
-            }
+        size_t count = 0;
+        const bool read_all = ForEachEntry(ToBytes(DB_ANV),
+                [&](const std::string& key, const std::string& value) {
+                    if (key == start) {
+                        return true;
+                    }
 
-            const auto anv_pub = AnvInToAnvPub(std::get<2>(anv));
-            anvs.push_back({std::get<0>(anv),
-                    std::get<1>(anv),
-                    anv_pub});
+                    if (count == max_count) {
+                        return false;
+                    }
 
-            iter->Next();
-        }
-        return anvs;
+                    AddressANV anv;
+                    if (ANVFromBytes(value, anv)) {
+                        anvs.push_back(anv);
+                        count++;
+                    }
+                    return true;
+                },
+                start);
+
+        return !read_all;
     }
 
     void ReferralsViewDB::GetAllRewardableANVs(
@@ -400,20 +809,20 @@ namespace referral
             int height,
             referral::AddressANVs& entrants) const
     {
-        const auto heap_size = GetLotteryHeapSize();
-        bool found_genesis = false;
-        for (uint64_t i = 0; i < heap_size; i++) {
-            LotteryEntrant v;
-            if (!m_db.Read(std::make_pair(DB_LOT_VAL, i), v)) {
-                break;
-            }
+        LOCK(m_cs);
+        LoadLotteryHeap();
 
-            auto maybe_anv = GetANV(std::get<2>(v));
-            if (!maybe_anv) {
+        entrants.reserve(entrants.size() + m_lottery_heap.size());
+
+        bool found_genesis = false;
+        for (const auto& v : m_lottery_heap) {
+            const auto it = m_lottery_entrant_anvs.find(std::get<2>(v));
+            if (it == m_lottery_entrant_anvs.end()) {
                 break;
             }
 
-            if (maybe_anv->address_type != 1 && maybe_anv->address_type != 2) {
+            const auto& anv = it->second;
+            if (anv.address_type != 1 && anv.address_type != 2) {
                 continue;
             }
 
@@ -421,31 +830,150 @@ namespace referral
              * After block 13499 the genesis address does not participate in the lottery.
              * So don't include the genesis address as an entrant.
              */
-            if (!found_genesis && height >= 13500 && maybe_anv->address == params.genesis_address) {
+            if (!found_genesis && height >= 13500 && anv.address == params.genesis_address) {
                 found_genesis = true;
                 continue;
             }
 
-            entrants.push_back(*maybe_anv);
+            entrants.push_back(anv);
         }
     }
 
-    bool ReferralsViewDB::FindLotteryPos(const Address& address, uint64_t& pos) const
+    const pog::AnvTree* ReferralsViewDB::GetRewardableANVTree(const Address& excluded) const
+    {
+        LOCK(m_cs);
+        LoadLotteryHeap();
+
+        if (!m_lottery_anvs_valid) {
+            return nullptr;
+        }
+
+        m_lottery_anvs.Exclude(excluded);
+        return &m_lottery_anvs;
+    }
+
+    /**
+     * Records the entrant's ANV and adds it to the rewardable ANVs if its
+     * address type can be rewarded. An entrant without an ANV invalidates the
+     * tree since GetAllRewardableANVs stops at such an entrant.
+     */
+    void ReferralsViewDB::IndexLotteryANV(const Address& address) const
     {
-        const auto heap_size = GetLotteryHeapSize();
+        ANVTuple anv;
+        if (!ReadEntry(std::make_pair(DB_ANV, address), anv)) {
+            LogPrintf("%s: lottery entrant %s has no ANV\n", __func__, address.GetHex());
+            m_lottery_entrant_anvs.erase(address);
+            m_lottery_anvs_valid = false;
+            return;
+        }
+
+        const auto address_type = std::get<0>(anv);
+        const auto anv_pub = AnvInToAnvPub(std::get<2>(anv));
+        m_lottery_entrant_anvs[address] = AddressANV{address_type, address, anv_pub};
+
+        if (!pog::IsValidAmbassadorDestination(address_type)) {
+            return;
+        }
+
+        m_lottery_anvs.Insert(address_type, address, anv_pub);
+    }
+
+    void ReferralsViewDB::UpdateLotteryANV(const Address& address, CAmount anv) const
+    {
+        if (!m_lottery_loaded || m_lottery_pos.count(address) == 0) {
+            return;
+        }
+
+        const auto it = m_lottery_entrant_anvs.find(address);
+        if (it != m_lottery_entrant_anvs.end()) {
+            it->second.anv = anv;
+        }
+
+        m_lottery_anvs.Update(address, anv);
+    }
+
+    /**
+     * Loads the lottery heap into memory and indexes entrant positions. The
+     * persisted position index is checked against the heap and written again
+     * if it is missing or stale.
+     */
+    void ReferralsViewDB::LoadLotteryHeap() const
+    {
+        if (m_lottery_loaded) {
+            return;
+        }
+
+        uint64_t heap_size = 0;
+        ReadEntry(DB_LOT_SIZE, heap_size);
+
+        m_lottery_heap.clear();
+        m_lottery_pos.clear();
+        m_lottery_heap.reserve(heap_size);
+
         for (uint64_t i = 0; i < heap_size; i++) {
             LotteryEntrant v;
-            if (!m_db.Read(std::make_pair(DB_LOT_VAL, i), v)) {
-                return false;
+            if (!ReadEntry(std::make_pair(DB_LOT_VAL, i), v)) {
+                LogPrintf("%s: lottery reservoir position %d is missing\n", __func__, i);
+                break;
             }
 
-            if (std::get<2>(v) == address) {
-                pos = i;
-                return true;
+            m_lottery_pos.emplace(std::get<2>(v), i);
+            m_lottery_heap.push_back(v);
+        }
+
+        m_lottery_anvs.Clear();
+        m_lottery_anvs_valid = true;
+        m_lottery_entrant_anvs.clear();
+        m_lottery_entrant_anvs.reserve(m_lottery_heap.size());
+        for (const auto& v : m_lottery_heap) {
+            IndexLotteryANV(std::get<2>(v));
+        }
+
+        //the persisted positions must agree with the slots. Heaps written
+        //before the index existed, or an index that disagrees, are reindexed.
+        bool indexed = HasEntry(DB_LOT_INDEXED);
+        for (const auto& pos : m_lottery_pos) {
+            if (!indexed) {
+                break;
+            }
+
+            uint64_t stored_pos;
+            if (!ReadEntry(std::make_pair(DB_LOT_POS, pos.first), stored_pos) ||
+                    stored_pos != pos.second) {
+                LogPrintf("%s: lottery position index is out of date, rebuilding\n", __func__);
+                indexed = false;
+            }
+        }
+
+        if (!indexed) {
+            for (const auto& pos : m_lottery_pos) {
+                WriteEntry(std::make_pair(DB_LOT_POS, pos.first), pos.second);
             }
+            WriteEntry(DB_LOT_INDEXED, true);
         }
 
-        pos = heap_size;
+        m_lottery_loaded = true;
+    }
+
+    void ReferralsViewDB::WriteLotteryEntrant(
+            uint64_t pos,
+            const LotteryEntrant& entrant)
+    {
+        assert(pos < m_lottery_heap.size());
+
+        m_lottery_heap[pos] = entrant;
+        m_lottery_pos[std::get<2>(entrant)] = pos;
+
+        WriteEntry(std::make_pair(DB_LOT_VAL, pos), entrant);
+        WriteEntry(std::make_pair(DB_LOT_POS, std::get<2>(entrant)), pos);
+    }
+
+    bool ReferralsViewDB::FindLotteryPos(const Address& address, uint64_t& pos) const
+    {
+        LoadLotteryHeap();
+
+        const auto it = m_lottery_pos.find(address);
+        pos = it != m_lottery_pos.end() ? it->second : m_lottery_heap.size();
         return true;
     }
 
@@ -471,6 +999,7 @@ namespace referral
             const uint64_t max_reservoir_size,
             LotteryUndos& undos)
     {
+        LOCK(m_cs);
         auto maybe_anv = GetANV(*address);
         if (!maybe_anv) return false;
 
@@ -497,12 +1026,12 @@ namespace referral
                 rand_value = hasher.GetHash();
             }
 
-            const auto weighted_key = pog::WeightedKeyForSampling(rand_value, maybe_anv->anv);
+            const auto key_estimate = pog::WeightedKeyEstimate(rand_value, maybe_anv->anv);
             const auto heap_size = GetLotteryHeapSize();
 
             debug("Lottery: Attempting to add %s with weighted Key %d",
                     CMeritAddress(address_type, *address).ToString(),
-                    static_cast<double>(weighted_key));
+                    key_estimate);
 
             // Note we are duplicating FindLotterPos inside both if conditions because
             // once the reservoir is full, we won't be attempting to add every time
@@ -516,6 +1045,7 @@ namespace referral
 
                 //Only add entrants that are not already participating.
                 if (pos == heap_size) {
+                    const auto weighted_key = pog::WeightedKeyForSampling(rand_value, maybe_anv->anv);
                     if (!InsertLotteryEntrant(
                                 weighted_key,
                                 address_type,
@@ -542,11 +1072,20 @@ namespace referral
                 }
 
                 const auto min_weighted_key = std::get<0>(*maybe_min_entrant);
+
+                //Most entrants fall well short of the smallest key once the
+                //reservoir is full, which the estimate settles without
+                //computing the exact key.
+                MaybeWeightedKey weighted_key;
+                if (!pog::KeyEstimateCannotExceed(key_estimate, GetMinLotteryKeyEstimate(min_weighted_key))) {
+                    weighted_key = pog::WeightedKeyForSampling(rand_value, maybe_anv->anv);
+                }
+
                 //Insert into reservoir only if the new key is bigger
                 //than the smallest key already there. Over time as the currency
                 //grows in amount there should always be a key greater than the
                 //smallest at some point as time goes on.
-                if (min_weighted_key < weighted_key) {
+                if (weighted_key && min_weighted_key < *weighted_key) {
                     uint64_t pos;
                     if (!FindLotteryPos(*address, pos)) {
                         return false;
@@ -559,7 +1098,7 @@ namespace referral
                         }
 
                         if (!InsertLotteryEntrant(
-                                    weighted_key,
+                                    *weighted_key,
                                     address_type,
                                     *address,
                                     max_reservoir_size)) {
@@ -580,7 +1119,7 @@ namespace referral
                 } else {
                     debug("\tLottery: %s didn't make the cut with key %d, min %d",
                             CMeritAddress(address_type, *address).ToString(),
-                            static_cast<double>(weighted_key),
+                            key_estimate,
                             static_cast<double>(min_weighted_key));
                 }
             }
@@ -602,6 +1141,7 @@ namespace referral
             const LotteryUndo& undo,
             const uint64_t max_reservoir_size)
     {
+        LOCK(m_cs);
         if (!RemoveFromLottery(undo.replaced_with)) {
             return false;
         }
@@ -625,19 +1165,25 @@ namespace referral
 
     uint64_t ReferralsViewDB::GetLotteryHeapSize() const
     {
-        uint64_t size = 0;
-        m_db.Read(DB_LOT_SIZE, size);
-        return size;
+        LoadLotteryHeap();
+        return m_lottery_heap.size();
     }
 
-    MaybeLotteryEntrant ReferralsViewDB::GetMinLotteryEntrant() const
+    double ReferralsViewDB::GetMinLotteryKeyEstimate(const pog::WeightedKey& min_key) const
     {
-        LotteryEntrant v;
+        if (!m_lottery_min_key || *m_lottery_min_key != min_key) {
+            m_lottery_min_key = min_key;
+            m_lottery_min_estimate = static_cast<double>(min_key);
+        }
+        return m_lottery_min_estimate;
+    }
 
-        const uint64_t first = 0;
-        return m_db.Read(std::make_pair(DB_LOT_VAL, first), v) ?
-            MaybeLotteryEntrant{v} :
-            MaybeLotteryEntrant{};
+    MaybeLotteryEntrant ReferralsViewDB::GetMinLotteryEntrant() const
+    {
+        LoadLotteryHeap();
+        return m_lottery_heap.empty() ?
+            MaybeLotteryEntrant{} :
+            MaybeLotteryEntrant{m_lottery_heap.front()};
     }
 
     /**
@@ -646,6 +1192,9 @@ namespace referral
      * parents until the right spot is found. If this function returns false, then
      * some bad things happened. You must not call this function when the heap is
      * full. You first must pop an element off the heap using PopMinFromLotteryHeap
+     *
+     * The heap is sifted in memory and only the touched slots, along with their
+     * position index entries, are written.
      */
     bool ReferralsViewDB::InsertLotteryEntrant(
             const pog::WeightedKey& key,
@@ -653,18 +1202,18 @@ namespace referral
             const Address& address,
             const uint64_t max_reservoir_size)
     {
-        auto heap_size = GetLotteryHeapSize();
+        LoadLotteryHeap();
+
+        const uint64_t heap_size = m_lottery_heap.size();
         assert(heap_size < max_reservoir_size);
 
+        m_lottery_heap.emplace_back();
+
         auto pos = heap_size;
 
         while (pos != 0) {
             const auto parent_pos = (pos - 1) / 2;
-
-            LotteryEntrant parent_value;
-            if (!m_db.Read(std::make_pair(DB_LOT_VAL, parent_pos), parent_value)) {
-                return false;
-            }
+            const auto& parent_value = m_lottery_heap[parent_pos];
 
             //We found our spot
             if (key > std::get<0>(parent_value)) {
@@ -672,22 +1221,20 @@ namespace referral
             }
 
             //Push our parent down since we are moving up.
-            if (!m_db.Write(std::make_tuple(DB_LOT_VAL, pos), parent_value)) {
-                return false;
-            }
+            WriteLotteryEntrant(pos, parent_value);
 
             pos = parent_pos;
         }
 
         //write final value
         debug("\tAdding to Reservoir %s at pos %d", CMeritAddress(address_type, address).ToString(), pos);
-        if (!m_db.Write(std::make_pair(DB_LOT_VAL, pos), std::make_tuple(key, address_type, address))) {
-            return false;
-        }
+        WriteLotteryEntrant(pos, LotteryEntrant{key, address_type, address});
+        IndexLotteryANV(address);
 
         uint64_t new_size = heap_size + 1;
-        if (!m_db.Write(DB_LOT_SIZE, new_size))
+        if (!WriteEntry(DB_LOT_SIZE, new_size)) {
             return false;
+        }
 
         assert(new_size <= max_reservoir_size);
         return true;
@@ -710,13 +1257,23 @@ namespace referral
     bool ReferralsViewDB::RemoveFromLottery(uint64_t current)
     {
         debug("\tPopping from lottery reservoir position %d", current);
-        auto heap_size = GetLotteryHeapSize();
+        LoadLotteryHeap();
+
+        const uint64_t heap_size = m_lottery_heap.size();
         if (heap_size == 0) return false;
 
-        LotteryEntrant last;
-        if (!m_db.Read(std::make_pair(DB_LOT_VAL, heap_size - 1), last)) {
-            return false;
-        }
+        const LotteryEntrant last = m_lottery_heap.back();
+
+        //the entrant leaving the reservoir, which is the last one if the
+        //position is past the end of the heap.
+        const auto& removed = current < heap_size ?
+            std::get<2>(m_lottery_heap[current]) :
+            std::get<2>(last);
+
+        EraseEntry(std::make_pair(DB_LOT_POS, removed));
+        m_lottery_pos.erase(removed);
+        m_lottery_anvs.Erase(removed);
+        m_lottery_entrant_anvs.erase(removed);
 
         LotteryEntrant smallest_val = last;
 
@@ -727,11 +1284,7 @@ namespace referral
             uint64_t right = 2 * current + 2;
 
             if (left < heap_size) {
-                LotteryEntrant left_val;
-                if (!m_db.Read(std::make_pair(DB_LOT_VAL, left), left_val)) {
-                    return false;
-                }
-
+                const auto& left_val = m_lottery_heap[left];
                 if (std::get<0>(left_val) < std::get<0>(smallest_val)) {
                     smallest = left;
                     smallest_val = left_val;
@@ -739,11 +1292,7 @@ namespace referral
             }
 
             if (right < heap_size) {
-                LotteryEntrant right_val;
-                if (!m_db.Read(std::make_pair(DB_LOT_VAL, right), right_val)) {
-                    return false;
-                }
-
+                const auto& right_val = m_lottery_heap[right];
                 if (std::get<0>(right_val) < std::get<0>(smallest_val)) {
                     smallest = right;
                     smallest_val = right_val;
@@ -752,9 +1301,7 @@ namespace referral
 
             if (smallest != current) {
                 //write the current element with the smallest
-                if (!m_db.Write(std::make_pair(DB_LOT_VAL, current), smallest_val)) {
-                    return false;
-                }
+                WriteLotteryEntrant(current, smallest_val);
 
                 //now go down the smallest path
                 current = smallest;
@@ -765,12 +1312,14 @@ namespace referral
 
         //finally write the value in the correct spot and reduce the heap
         //size by 1
-        if (!m_db.Write(std::make_pair(DB_LOT_VAL, current), last)) {
-            return false;
+        if (current < heap_size - 1) {
+            WriteLotteryEntrant(current, last);
         }
 
+        m_lottery_heap.pop_back();
+
         uint64_t new_size = heap_size - 1;
-        if (!m_db.Write(DB_LOT_SIZE, new_size)) {
+        if (!WriteEntry(DB_LOT_SIZE, new_size)) {
             return false;
         }
 
@@ -849,10 +1398,10 @@ namespace referral
             CAmount &updated_amount)
     {
         uint64_t total_confirmations = 0;
-        m_db.Read(DB_CONFIRMATION_TOTAL, total_confirmations);
+        ReadEntry(DB_CONFIRMATION_TOTAL, total_confirmations);
 
         ConfirmationPair confirmation;
-        if (!m_db.Read(
+        if (!ReadEntry(
                     std::make_pair(DB_CONFIRMATION, address),
                     confirmation)) {
             confirmation.first = total_confirmations;
@@ -861,7 +1410,7 @@ namespace referral
 
             //We have a new confirmed address so add it to the end of the invite lottery
             //and index it.
-            if (!m_db.Write(
+            if (!WriteEntry(
                         std::make_pair(DB_CONFIRMATION_IDX, total_confirmations),
                         std::make_pair(
                             address_type,
@@ -869,7 +1418,7 @@ namespace referral
                 return false;
             }
 
-            if (!m_db.Write(DB_CONFIRMATION_TOTAL, total_confirmations + 1)) {
+            if (!WriteEntry(DB_CONFIRMATION_TOTAL, total_confirmations + 1)) {
                 return false;
             }
         } else {
@@ -881,13 +1430,13 @@ namespace referral
             //DisconnectBlock correctly.
             assert(total_confirmations > 0);
             if (confirmation.second == 0 && confirmation.first == total_confirmations - 1) {
-                if (!m_db.Write(DB_CONFIRMATION_TOTAL, total_confirmations - 1)) {
+                if (!WriteEntry(DB_CONFIRMATION_TOTAL, total_confirmations - 1)) {
                     return false;
                 }
-                if (!m_db.Erase(std::make_pair(DB_CONFIRMATION, address))) {
+                if (!EraseEntry(std::make_pair(DB_CONFIRMATION, address))) {
                     return false;
                 }
-                if (!m_db.Erase(std::make_pair(DB_CONFIRMATION_IDX, confirmation.first))) {
+                if (!EraseEntry(std::make_pair(DB_CONFIRMATION_IDX, confirmation.first))) {
                     return false;
                 }
                 return true;
@@ -898,7 +1447,7 @@ namespace referral
             }
         }
 
-        if (!m_db.Write(
+        if (!WriteEntry(
                     std::make_pair(DB_CONFIRMATION, address),
                     confirmation)) {
             return false;
@@ -909,7 +1458,7 @@ namespace referral
 
     bool ReferralsViewDB::Exists(const referral::Address& address) const
     {
-        return m_db.Exists(std::make_pair(DB_REFERRALS, address));
+        return HasEntry(std::make_pair(DB_REFERRALS, address));
     }
 
     bool ReferralsViewDB::Exists(
@@ -922,13 +1471,13 @@ namespace referral
         }
 
         return maybe_normalized.size() > 0 &&
-            m_db.Exists(std::make_pair(DB_ALIAS, maybe_normalized));
+            HasEntry(std::make_pair(DB_ALIAS, maybe_normalized));
     }
 
     bool ReferralsViewDB::IsConfirmed(const referral::Address& address) const
     {
         ConfirmationPair confirmation;
-        if (!m_db.Read(
+        if (!ReadEntry(
                     std::make_pair(DB_CONFIRMATION, address),
                     confirmation)) {
             return false;
@@ -947,36 +1496,24 @@ namespace referral
     bool ReferralsViewDB::ConfirmAllPreDaedalusAddresses()
     {
         //Check to see if addresses have already been confirmed.
-        if (m_db.Exists(DB_PRE_DAEDALUS_CONFIRMED)) {
+        if (HasEntry(DB_PRE_DAEDALUS_CONFIRMED)) {
             return true;
         }
 
-        std::unique_ptr<CDBIterator> iter{m_db.NewIterator()};
-        iter->SeekToFirst();
-
         AddressPairs addresses;
+        const bool read_all = ForEachEntry(ToBytes(DB_REFERRALS),
+                [&addresses](const std::string&, const std::string& value) {
+                    MutableReferral referral;
+                    if (!FromBytes(value, referral)) {
+                        return false;
+                    }
 
-        auto address = std::make_pair(DB_REFERRALS, Address{});
-        while (iter->Valid()) {
-            // filter non ANV addresses
-            if (!iter->GetKey(address)) {
-                iter->Next();
-                continue;
-            }
-
-            if (address.first != DB_REFERRALS) {
-                iter->Next();
-                continue;
-            }
-
-            MutableReferral referral;
-            if (!iter->GetValue(referral)) {
-                return false;
-            }
-
-            addresses.push_back({referral.addressType, referral.GetAddress()});
+                    addresses.push_back({referral.addressType, referral.GetAddress()});
+                    return true;
+                });
 
-            iter->Next();
+        if (!read_all) {
+            return false;
         }
 
         debug("Confirming %d pre daedalus addresses", addresses.size());
@@ -994,7 +1531,7 @@ namespace referral
         }
 
         //Mark state in DB that all addresses before daedalus have been confirmed.
-        if (!m_db.Write(DB_PRE_DAEDALUS_CONFIRMED, true)) {
+        if (!WriteEntry(DB_PRE_DAEDALUS_CONFIRMED, true)) {
             return false;
         }
 
@@ -1003,26 +1540,26 @@ namespace referral
 
     bool ReferralsViewDB::AreAllPreDaedalusAddressesConfirmed() const
     {
-        return m_db.Exists(DB_PRE_DAEDALUS_CONFIRMED);
+        return HasEntry(DB_PRE_DAEDALUS_CONFIRMED);
     }
 
     uint64_t ReferralsViewDB::GetTotalConfirmations() const
     {
         uint64_t total = 0;
-        m_db.Read(DB_CONFIRMATION_TOTAL, total);
+        ReadEntry(DB_CONFIRMATION_TOTAL, total);
         return total;
     }
 
     MaybeConfirmedAddress ReferralsViewDB::GetConfirmation(uint64_t idx) const
     {
         ConfirmationVal val;
-        if (!m_db.Read(std::make_pair(DB_CONFIRMATION_IDX, idx), val)) {
+        if (!ReadEntry(std::make_pair(DB_CONFIRMATION_IDX, idx), val)) {
             return MaybeConfirmedAddress{};
         }
 
         ConfirmationPair pair{0,0};
 
-        if (!m_db.Read(
+        if (!ReadEntry(
                     std::make_pair(DB_CONFIRMATION, val.second),
                     pair)) {
             return MaybeConfirmedAddress{};
@@ -1035,7 +1572,7 @@ namespace referral
     {
         ConfirmationPair pair{0,0};
 
-        if (!m_db.Read(
+        if (!ReadEntry(
                     std::make_pair(DB_CONFIRMATION, address),
                     pair)) {
             return MaybeConfirmedAddress{};
@@ -11,9 +11,15 @@
 #include "primitives/referral.h"
 #include "primitives/transaction.h"
 #include "consensus/params.h"
+#include "pog/anvtree.h"
 #include "pog/wrs.h"
+#include "sync.h"
 
 #include <boost/optional.hpp>
+#include <atomic>
+#include <functional>
+#include <map>
+#include <unordered_map>
 #include <vector>
 
 namespace referral
@@ -26,9 +32,13 @@ using Addresses = std::vector<Address>;
 using MaybeWeightedKey = boost::optional<pog::WeightedKey>;
 using LotteryEntrant = std::tuple<pog::WeightedKey, char, Address>;
 using MaybeLotteryEntrant = boost::optional<LotteryEntrant>;
+using LotteryEntrants = std::vector<LotteryEntrant>;
+using LotteryPositions = std::unordered_map<Address, uint64_t>;
 using AddressPair = std::pair<char, Address>;
 using MaybeAddressPair = boost::optional<AddressPair>;
 using TransactionHash = uint256;
+using ANVChange = std::tuple<char, Address, CAmount>;
+using ANVChanges = std::vector<ANVChange>;
 
 struct AddressANV
 {
@@ -73,6 +83,17 @@ struct LotteryUndo
 
 using LotteryUndos = std::vector<LotteryUndo>;
 
+/**
+ * Entry lookups and writes made through the referral DB since it was opened.
+ * Lookups answered by the changes pending a Flush are not disk reads.
+ */
+struct ReferralsDBStats
+{
+    uint64_t reads = 0;
+    uint64_t disk_reads = 0;
+    uint64_t writes = 0;
+};
+
 class ReferralsViewDB
 {
 protected:
@@ -100,8 +121,21 @@ public:
     ChildAddresses GetChildren(const Address&) const;
 
     bool UpdateANV(char address_type, const Address&, CAmount);
+
+    /**
+     * Applies all the ANV changes of a block at once. Every affected ancestor
+     * is read and written once no matter how many of its descendants changed,
+     * and ends up exactly as if UpdateANV was called for each change in order.
+     */
+    bool UpdateANVs(const ANVChanges&);
     MaybeAddressANV GetANV(const Address&) const;
     AddressANVs GetAllANVs() const;
+
+    /**
+     * Appends up to max_count ANVs in address order, starting after the given
+     * address or at the first one. Returns true if there are more to read.
+     */
+    bool GetANVsAfter(const MaybeAddress& after, size_t max_count, AddressANVs&) const;
     bool OrderReferrals(referral::ReferralRefs& refs);
 
     bool InsertReferral(
@@ -116,6 +150,16 @@ public:
             int height,
             AddressANVs&) const;
 
+    /**
+     * The rewardable lottery entrants sorted by ANV, kept up to date as the
+     * reservoir and ANVs change. The excluded address, normally the genesis
+     * address, is left out. Returns nullptr if some entrant has no ANV, in
+     * which case GetAllRewardableANVs has to be used instead. The tree only
+     * changes as blocks are connected, so it may be used while cs_main is
+     * held.
+     */
+    const pog::AnvTree* GetRewardableANVTree(const Address& excluded) const;
+
     bool AddAddressToLottery(
             int height,
             uint256,
@@ -146,10 +190,116 @@ public:
     MaybeConfirmedAddress GetConfirmation(uint64_t idx) const;
     MaybeConfirmedAddress GetConfirmation(char address_type, const Address& address) const;
 
+    /**
+     * Writes all pending changes to disk in a single batch along with the
+     * hash of the block the referral state corresponds to.
+     */
+    bool Flush(const uint256& best_block);
+
+    /**
+     * Block the referral state on disk corresponds to. Null if the database
+     * was last written before the marker existed.
+     */
+    uint256 GetBestBlock() const;
+
+    /**
+     * Memory used by the changes waiting for the next Flush.
+     */
+    size_t DynamicMemoryUsage() const;
+
+    /**
+     * Lookup and write counters since the DB was opened.
+     */
+    ReferralsDBStats GetStats() const;
+
+    /**
+     * Upgrades the database from older formats. Must be called before any
+     * other use of the database.
+     */
+    bool Upgrade();
 
 private:
+    /**
+     * Changes since the last Flush, keyed by serialized DB key. An empty value
+     * marks an erased key. All reads go through this overlay first so callers
+     * see their own writes before they reach disk.
+     */
+    using RawValue = boost::optional<std::string>;
+    using PendingEntries = std::map<std::string, RawValue>;
+    using EntryVisitor = std::function<bool(const std::string&, const std::string&)>;
+
+    /**
+     * Guards the pending changes and the lottery and ANV mirrors below.
+     * Blocks are connected and flushed under cs_main, but RPC and wallet
+     * lookups read the DB without it.
+     */
+    mutable CCriticalSection m_cs;
+
+    mutable PendingEntries m_pending;
+    mutable size_t m_pending_usage = 0;
+    mutable std::atomic<uint64_t> m_reads{0};
+    mutable std::atomic<uint64_t> m_disk_reads{0};
+    mutable std::atomic<uint64_t> m_writes{0};
+
+    template <typename K, typename V>
+    bool ReadEntry(const K& key, V& value) const;
+
+    template <typename K>
+    bool HasEntry(const K& key) const;
+
+    template <typename K, typename V>
+    bool WriteEntry(const K& key, const V& value) const;
+
+    template <typename K>
+    bool EraseEntry(const K& key) const;
+
+    void StageEntry(std::string key, RawValue value) const;
+    bool ForEachEntry(
+            const std::string& prefix,
+            const EntryVisitor& visit,
+            const std::string& start = std::string{}) const;
+
+    /**
+     * In-memory mirror of the lottery reservoir heap along with the position
+     * of every entrant. It is loaded once from the DB and kept in sync by
+     * InsertLotteryEntrant and RemoveFromLottery, so membership checks and
+     * sifting never have to read the heap from disk.
+     */
+    mutable bool m_lottery_loaded = false;
+    mutable LotteryEntrants m_lottery_heap;
+    mutable LotteryPositions m_lottery_pos;
+
+    /**
+     * ANVs of the rewardable entrants in the reservoir. Updated whenever an
+     * entrant joins or leaves the reservoir and whenever the ANV of an
+     * entrant is written.
+     */
+    mutable pog::AnvTree m_lottery_anvs;
+    mutable bool m_lottery_anvs_valid = false;
+
+    /**
+     * Current ANV of every entrant in the reservoir, rewardable or not, kept
+     * in sync the same way. GetAllRewardableANVs lists the entrants from it
+     * without reading the DB.
+     */
+    mutable std::unordered_map<Address, AddressANV> m_lottery_entrant_anvs;
+
+    void LoadLotteryHeap() const;
+    void IndexLotteryANV(const Address&) const;
+    void UpdateLotteryANV(const Address&, CAmount anv) const;
+    void WriteLotteryEntrant(uint64_t pos, const LotteryEntrant&);
+
     uint64_t GetLotteryHeapSize() const;
     MaybeLotteryEntrant GetMinLotteryEntrant() const;
+
+    /**
+     * The smallest key in the reservoir in double precision. Converting a big
+     * float to a double is slow, so the value is kept until the smallest key
+     * changes.
+     */
+    double GetMinLotteryKeyEstimate(const pog::WeightedKey& min_key) const;
+    mutable MaybeWeightedKey m_lottery_min_key;
+    mutable double m_lottery_min_estimate = 0;
     bool FindLotteryPos(const Address& address, uint64_t& pos) const;
 
     bool InsertLotteryEntrant(
@@ -3,17 +3,33 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "referrals.h"
+#include "memusage.h"
 
 #include <utility>
 
 namespace referral
 {
-ReferralsViewCache::ReferralsViewCache(ReferralsViewDB* db) : m_db{db}
+ReferralsViewCache::ReferralsViewCache(ReferralsViewDB* db, size_t max_size) :
+    m_db{db}, m_max_size{max_size}
 {
     assert(db);
 };
 
 namespace {
+    // value plus two hashed and one sequenced index links
+    size_t ReferralUsage(const Referral& ref)
+    {
+        return memusage::MallocUsage(sizeof(Referral) + 4 * sizeof(void*)) +
+            memusage::DynamicUsage(ref.signature) +
+            (ref.alias.capacity() > 15 ? memusage::MallocUsage(ref.alias.capacity() + 1) : 0);
+    }
+
+    // value plus one hashed and one sequenced index links
+    size_t MissingUsage()
+    {
+        return memusage::MallocUsage(sizeof(Address) + 3 * sizeof(void*));
+    }
+
     class ReferralIdVisitor : public boost::static_visitor<MaybeReferral>
     {
         private:
@@ -38,34 +54,79 @@ namespace {
     };
 }
 
+MaybeReferral ReferralsViewCache::FindInCache(const Address& address) const
+{
+    LOCK(m_cs_cache);
+    auto it = referrals_index.find(address);
+    if (it == referrals_index.end()) {
+        return {};
+    }
+
+    auto& recent = referrals_index.get<by_recent>();
+    recent.relocate(recent.begin(), referrals_index.project<by_recent>(it));
+    m_hits++;
+    return *it;
+}
+
+MaybeReferral ReferralsViewCache::FindInCache(const uint256& hash) const
+{
+    LOCK(m_cs_cache);
+    auto& by_hashes = referrals_index.get<by_hash>();
+    auto it = by_hashes.find(hash);
+    if (it == by_hashes.end()) {
+        return {};
+    }
+
+    auto& recent = referrals_index.get<by_recent>();
+    recent.relocate(recent.begin(), referrals_index.project<by_recent>(it));
+    m_hits++;
+    return *it;
+}
+
+bool ReferralsViewCache::KnownMissing(const Address& address, uint64_t& generation) const
+{
+    LOCK(m_cs_cache);
+    generation = m_generation;
+
+    auto it = missing_index.find(address);
+    if (it == missing_index.end()) {
+        return false;
+    }
+
+    auto& recent = missing_index.get<by_recent>();
+    recent.relocate(recent.begin(), missing_index.project<by_recent>(it));
+    m_missing_hits++;
+    return true;
+}
+
 MaybeReferral ReferralsViewCache::GetReferral(const Address& address) const
 {
-    {
-        LOCK(m_cs_cache);
-        auto it = referrals_index.find(address);
-        if (it != referrals_index.end()) {
-            return *it;
-        }
+    if (auto ref = FindInCache(address)) {
+        return ref;
     }
 
+    uint64_t generation;
+    if (KnownMissing(address, generation)) {
+        return {};
+    }
+
+    m_misses++;
     if (auto ref = m_db->GetReferral(address)) {
         InsertReferralIntoCache(*ref);
         return ref;
     }
 
+    InsertMissingIntoCache(address, generation);
     return {};
 }
 
 MaybeReferral ReferralsViewCache::GetReferral(const uint256& hash) const
 {
-    {
-        LOCK(m_cs_cache);
-        auto it = referrals_index.get<by_hash>().find(hash);
-        if (it != referrals_index.get<by_hash>().end()) {
-            return *it;
-        }
+    if (auto ref = FindInCache(hash)) {
+        return ref;
     }
 
+    m_misses++;
     if (auto ref = m_db->GetReferral(hash)) {
         InsertReferralIntoCache(*ref);
         return ref;
@@ -95,6 +156,7 @@ MaybeReferral ReferralsViewCache::GetReferral(const std::string& alias, bool nor
         }
     }
 
+    m_misses++;
     if (auto ref = m_db->GetReferral(maybe_normalized, false)) {
         LOCK(m_cs_cache);
         alias_index[maybe_normalized] = ref->GetAddress();
@@ -112,34 +174,12 @@ MaybeReferral ReferralsViewCache::GetReferral(const ReferralId& id, bool normali
 
 bool ReferralsViewCache::Exists(const uint256& hash) const
 {
-    {
-        LOCK(m_cs_cache);
-        if (referrals_index.get<by_hash>().count(hash) > 0) {
-            return true;
-        }
-    }
-
-    if (auto ref = m_db->GetReferral(hash)) {
-        InsertReferralIntoCache(*ref);
-        return true;
-    }
-
-    return false;
+    return static_cast<bool>(GetReferral(hash));
 }
 
 bool ReferralsViewCache::Exists(const Address& address) const
 {
-    {
-        LOCK(m_cs_cache);
-        if (referrals_index.count(address) > 0) {
-            return true;
-        }
-    }
-    if (auto ref = m_db->GetReferral(address)) {
-        InsertReferralIntoCache(*ref);
-        return true;
-    }
-    return false;
+    return static_cast<bool>(GetReferral(address));
 }
 
 bool ReferralsViewCache::Exists(const std::string& alias, bool normalize_alias) const
@@ -157,10 +197,12 @@ bool ReferralsViewCache::Exists(const std::string& alias, bool normalize_alias)
     {
         LOCK(m_cs_cache);
         if (alias_index.count(maybe_normalized) > 0) {
+            m_hits++;
             return true;
         }
     }
 
+    m_misses++;
     if (auto ref = m_db->GetReferral(maybe_normalized, false)) {
         LOCK(m_cs_cache);
         alias_index[maybe_normalized] = ref->GetAddress();
@@ -175,7 +217,42 @@ bool ReferralsViewCache::Exists(const std::string& alias, bool normalize_alias)
 void ReferralsViewCache::InsertReferralIntoCache(const Referral& ref) const
 {
     LOCK(m_cs_cache);
-    referrals_index.insert(ref);
+    missing_index.erase(ref.GetAddress());
+
+    auto inserted = referrals_index.insert(ref);
+    auto& recent = referrals_index.get<by_recent>();
+    recent.relocate(recent.begin(), referrals_index.project<by_recent>(inserted.first));
+
+    if (inserted.second) {
+        m_usage += ReferralUsage(ref);
+    }
+
+    while (referrals_index.size() > m_max_size) {
+        const auto& evicted = recent.back();
+        RemoveAliasFromCache(evicted);
+        m_usage -= ReferralUsage(evicted);
+        recent.pop_back();
+        m_evictions++;
+    }
+}
+
+void ReferralsViewCache::InsertMissingIntoCache(const Address& address, uint64_t generation) const
+{
+    LOCK(m_cs_cache);
+
+    // the address may have been inserted since the DB said it was missing
+    if (generation != m_generation) {
+        return;
+    }
+
+    auto inserted = missing_index.insert(address);
+    auto& recent = missing_index.get<by_recent>();
+    recent.relocate(recent.begin(), missing_index.project<by_recent>(inserted.first));
+
+    while (missing_index.size() > m_max_size) {
+        recent.pop_back();
+        m_evictions++;
+    }
 }
 
 void ReferralsViewCache::RemoveAliasFromCache(const Referral& ref) const {
@@ -187,9 +264,30 @@ void ReferralsViewCache::RemoveAliasFromCache(const Referral& ref) const {
     }
 }
 
+void ReferralsViewCache::EraseReferralFromCache(const Address& address) const
+{
+    auto it = referrals_index.find(address);
+    if (it == referrals_index.end()) {
+        return;
+    }
+
+    m_usage -= ReferralUsage(*it);
+    referrals_index.erase(it);
+}
+
+bool ReferralsViewCache::InsertReferral(const Referral& ref, bool allow_no_parent, bool normalize_alias)
+{
+    LOCK(m_cs_cache);
+    m_generation++;
+    missing_index.erase(ref.GetAddress());
+
+    return m_db->InsertReferral(ref, allow_no_parent, normalize_alias);
+}
+
 bool ReferralsViewCache::RemoveReferral(const Referral& ref) const
 {
-    referrals_index.erase(ref.GetAddress());
+    LOCK(m_cs_cache);
+    EraseReferralFromCache(ref.GetAddress());
     RemoveAliasFromCache(ref);
 
     return m_db->RemoveReferral(ref);
@@ -269,5 +367,25 @@ MaybeConfirmedAddress ReferralsViewCache::GetConfirmation(const Address& address
     return m_db->GetConfirmation(ref->addressType, address);
 }
 
+ReferralsCacheStats ReferralsViewCache::GetStats() const
+{
+    LOCK(m_cs_cache);
+
+    ReferralsCacheStats stats;
+    stats.referrals = referrals_index.size();
+    stats.missing = missing_index.size();
+    stats.max_size = m_max_size;
+    stats.usage = m_usage +
+        memusage::MallocUsage(sizeof(void*) * referrals_index.bucket_count()) +
+        memusage::MallocUsage(sizeof(void*) * referrals_index.get<by_hash>().bucket_count()) +
+        MissingUsage() * missing_index.size() +
+        memusage::MallocUsage(sizeof(void*) * missing_index.bucket_count()) +
+        memusage::DynamicUsage(alias_index);
+    stats.hits = m_hits;
+    stats.misses = m_misses;
+    stats.missing_hits = m_missing_hits;
+    stats.evictions = m_evictions;
+    return stats;
+}
 
 }
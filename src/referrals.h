@@ -15,17 +15,23 @@
 
 #include <boost/multi_index/global_fun.hpp>
 #include <boost/multi_index/hashed_index.hpp>
+#include <boost/multi_index/identity.hpp>
 #include <boost/multi_index/mem_fun.hpp>
 #include <boost/multi_index/member.hpp>
+#include <boost/multi_index/sequenced_index.hpp>
 #include <boost/multi_index/tag.hpp>
 #include <boost/multi_index_container.hpp>
 #include <boost/optional.hpp>
+#include <atomic>
 #include <unordered_map>
 
 using namespace boost::multi_index;
 
 namespace referral
 {
+//! Default for -referralcache, the number of referrals kept in memory
+static const size_t DEFAULT_REFERRALS_CACHE_SIZE = 100000;
+
 template <unsigned int BITS>
 class SaltedHasher
 {
@@ -47,6 +53,8 @@ struct by_address {
 };
 struct by_hash {
 };
+struct by_recent {
+};
 
 using ReferralIndex = multi_index_container<
     Referral,
@@ -57,25 +65,68 @@ using ReferralIndex = multi_index_container<
         // use non-unique here to support empty tags.
         // otherwise it won't add such referrals to index
         // uniqueness is provided by validation
-        hashed_non_unique<tag<by_hash>, const_mem_fun<Referral, const uint256&, &Referral::GetHash>, SaltedHasher<256>>>>;
+        hashed_non_unique<tag<by_hash>, const_mem_fun<Referral, const uint256&, &Referral::GetHash>, SaltedHasher<256>>,
+        // most recently used first, evicted from the back
+        sequenced<tag<by_recent>>>>;
+
+// addresses known not to be beaconed, most recently used first
+using MissingIndex = multi_index_container<
+    Address,
+    indexed_by<
+        hashed_unique<tag<by_address>, identity<Address>, SaltedHasher<160>>,
+        sequenced<tag<by_recent>>>>;
 
 using AliasIndex = std::unordered_map<std::string, Address>;
 using ConfirmationsIndex = std::unordered_map<Address, int>;
 
+struct ReferralsCacheStats {
+    size_t referrals = 0;
+    size_t missing = 0;
+    size_t max_size = 0;
+    size_t usage = 0;
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t missing_hits = 0;
+    uint64_t evictions = 0;
+};
+
+/**
+ * Read-through cache of the referrals DB. Both the referrals found and the
+ * addresses found missing are kept in LRU order and bounded by max_size.
+ */
 class ReferralsViewCache
 {
 private:
     mutable CCriticalSection m_cs_cache;
     ReferralsViewDB* m_db;
+    const size_t m_max_size;
     mutable ReferralIndex referrals_index;
+    mutable MissingIndex missing_index;
     mutable AliasIndex alias_index;
     mutable ConfirmationsIndex confirmations_index;
 
+    mutable size_t m_usage = 0;
+    // bumped on every insert so lookups racing with it don't cache a miss
+    mutable uint64_t m_generation = 0;
+    mutable std::atomic<uint64_t> m_hits{0};
+    mutable std::atomic<uint64_t> m_misses{0};
+    mutable std::atomic<uint64_t> m_missing_hits{0};
+    mutable std::atomic<uint64_t> m_evictions{0};
+
     void InsertReferralIntoCache(const Referral&) const;
+    void InsertMissingIntoCache(const Address&, uint64_t generation) const;
     void RemoveAliasFromCache(const Referral&) const;
+    void EraseReferralFromCache(const Address&) const;
+
+    /** Look up the cache and mark the referral as recently used */
+    MaybeReferral FindInCache(const Address&) const;
+    MaybeReferral FindInCache(const uint256&) const;
+
+    /** Check if the address was already found missing from the DB */
+    bool KnownMissing(const Address&, uint64_t& generation) const;
 
 public:
-    ReferralsViewCache(ReferralsViewDB*);
+    ReferralsViewCache(ReferralsViewDB*, size_t max_size = DEFAULT_REFERRALS_CACHE_SIZE);
 
     /** Get referral by address */
     MaybeReferral GetReferral(const Address&) const;
@@ -98,6 +149,9 @@ public:
     /** Check if referral alias occupied */
     bool Exists( const std::string& alias, bool normalize_alias) const;
 
+    /** Insert referral into the DB, forgetting it was missing */
+    bool InsertReferral(const Referral&, bool allow_no_parent, bool normalize_alias);
+
     /** Remove referral from cache */
     bool RemoveReferral(const Referral&) const;
 
@@ -115,6 +169,9 @@ public:
 
     // Get address confirmations
     MaybeConfirmedAddress GetConfirmation(const Address& address) const;
+
+    /** Hit, miss and eviction counters and memory used by the cache */
+    ReferralsCacheStats GetStats() const;
 };
 
 } // namespace referral
@@ -86,18 +86,17 @@ double GetDifficulty(const CBlockIndex* blockindex)
     return dDiff;
 }
 
-std::string GetCycleStr(std::set<uint32_t> cycle)
+std::string GetCycleStr(const cuckoo::Cycle& cycle)
 {
     std::stringstream cycleStr;
-    auto it = cycle.begin();
 
-    do {
-        cycleStr << "0x" << std::hex << *it;
-
-        if(++it != cycle.end()) {
+    for (auto it = cycle.begin(); it != cycle.end(); ++it) {
+        if (it != cycle.begin()) {
             cycleStr << " ";
         }
-    } while (it != cycle.end());
+
+        cycleStr << "0x" << std::hex << *it;
+    }
 
     return cycleStr.str();
 }
@@ -153,6 +153,7 @@ static const CRPCConvertParam vRPCConvertParams[] =
     { "getaddressmempoolreferrals", 0, "addresses"},
     { "getaddressrewards", 0, "addresses"},
     { "getaddressanv", 0, "addresses"},
+    { "getallanvs", 1, "count"},
     { "bumpfee", 1, "options" },
     { "logging", 0, "include" },
     { "logging", 1, "exclude" },
@@ -15,6 +15,7 @@
 #include "core_io.h"
 #include "cuckoo/cuckoo.h"
 #include "cuckoo/miner.h"
+#include "cuckoo/solver_pool.h"
 #include "init.h"
 #include "miner.h"
 #include "net.h"
@@ -27,9 +28,12 @@
 #include "utilstrencodings.h"
 #include "validation.h"
 #include "validationinterface.h"
-#include "wallet/wallet.h"
 #include "warnings.h"
 
+#ifdef ENABLE_WALLET
+#include "wallet/wallet.h"
+#endif
+
 #include <numeric>
 
 #include <memory>
@@ -132,7 +136,9 @@ UniValue generateBlocks(
     UniValue blockHashes(UniValue::VARR);
     auto consensusParams = Params().GetConsensus();
 
-    ctpl::thread_pool pool{nThreads};
+    // borrowed from the solver pool, so consecutive calls reuse the
+    // solver buffers and threads
+    cuckoo::SolverLease solver;
 
     do {
         const auto pblocktemplate =
@@ -147,17 +153,23 @@ UniValue generateBlocks(
             IncrementExtraNonce(pblock, chainActive.Tip(), nExtraNonce);
         }
 
-        std::set<uint32_t> cycle;
+        if (!solver || solver->EdgeBits() != pblock->nEdgeBits) {
+            solver.reset();
+            solver = cuckoo::AcquireSolver(
+                    pblock->nEdgeBits,
+                    consensusParams.nCuckooProofSize,
+                    nThreads);
+        }
+
+        cuckoo::Cycle cycle;
         while (nMaxTries > 0
                 && pblock->nNonce < nInnerLoopCount
                 && !cuckoo::FindProofOfWorkAdvanced(
                     pblock->GetHash(),
                     pblock->nBits,
-                    pblock->nEdgeBits,
                     cycle,
                     consensusParams,
-                    nThreads,
-                    pool)) {
+                    *solver)) {
 
             ++pblock->nNonce;
             --nMaxTries;
@@ -256,6 +268,14 @@ UniValue getmininginfo(const JSONRPCRequest& request)
             "  \"pooledtx\": n              (numeric) The size of the mempool\n"
             "  \"pooledref\": n             (numeric) The size of the referrals mempool\n"
             "  \"chain\": \"xxxx\",         (string) current network name as defined in BIP70 (main, test, regtest)\n"
+            "  \"solverpool\": {            (json object) pow solvers shared by the miner and the generate calls\n"
+            "     \"created\": n,           (numeric) Solvers created because no idle one matched\n"
+            "     \"reused\": n,            (numeric) Solvers reused from the idle ones\n"
+            "     \"evicted\": n,           (numeric) Idle solvers freed to stay under -minesolvercache\n"
+            "     \"inuse\": n,             (numeric) Solvers in use\n"
+            "     \"idle\": n,              (numeric) Idle solvers\n"
+            "     \"idlebytes\": n          (numeric) Memory held by the idle solvers\n"
+            "  }\n"
             "}\n"
             "\nExamples:\n"
             + HelpExampleCli("getmininginfo", "")
@@ -285,6 +305,16 @@ UniValue getmininginfo(const JSONRPCRequest& request)
     obj.push_back(Pair("pooledtx",           (uint64_t)mempool.size()));
     obj.push_back(Pair("pooledref",          (uint64_t)mempoolReferral.Size()));
     obj.push_back(Pair("chain",              Params().NetworkIDString()));
+
+    const auto poolStats = cuckoo::GetSolverPoolStats();
+    UniValue solverPool(UniValue::VOBJ);
+    solverPool.push_back(Pair("created",     poolStats.created));
+    solverPool.push_back(Pair("reused",      poolStats.reused));
+    solverPool.push_back(Pair("evicted",     poolStats.evicted));
+    solverPool.push_back(Pair("inuse",       poolStats.inUse));
+    solverPool.push_back(Pair("idle",        poolStats.idle));
+    solverPool.push_back(Pair("idlebytes",   poolStats.idleMemory));
+    obj.push_back(Pair("solverpool",         solverPool));
     return obj;
 }
 
@@ -21,6 +21,7 @@
 
 #include "rpc/safemode.h"
 #include "pog/anv.h"
+#include "referrals.h"
 
 #ifdef ENABLE_WALLET
 #include "wallet/rpcwallet.h"
@@ -618,6 +619,21 @@ static UniValue RPCLockedMemoryInfo()
     return obj;
 }
 
+static UniValue RPCReferralsCacheInfo()
+{
+    const auto stats = prefviewcache->GetStats();
+    UniValue obj(UniValue::VOBJ);
+    obj.push_back(Pair("referrals", uint64_t(stats.referrals)));
+    obj.push_back(Pair("missing", uint64_t(stats.missing)));
+    obj.push_back(Pair("max_size", uint64_t(stats.max_size)));
+    obj.push_back(Pair("usage", uint64_t(stats.usage)));
+    obj.push_back(Pair("hits", stats.hits));
+    obj.push_back(Pair("missing_hits", stats.missing_hits));
+    obj.push_back(Pair("misses", stats.misses));
+    obj.push_back(Pair("evictions", stats.evictions));
+    return obj;
+}
+
 #ifdef HAVE_MALLOC_INFO
 static std::string RPCMallocInfo()
 {
@@ -659,6 +675,16 @@ UniValue getmemoryinfo(const JSONRPCRequest& request)
             "    \"locked\": xxxxxx,       (numeric) Amount of bytes that succeeded locking. If this number is smaller than total, locking pages failed at some point and key data could be swapped to disk.\n"
             "    \"chunks_used\": xxxxx,   (numeric) Number allocated chunks\n"
             "    \"chunks_free\": xxxxx,   (numeric) Number unused chunks\n"
+            "  },\n"
+            "  \"referrals\": {           (json object) Information about the referrals cache\n"
+            "    \"referrals\": xxxxx,     (numeric) Number of referrals cached\n"
+            "    \"missing\": xxxxx,       (numeric) Number of unbeaconed addresses cached\n"
+            "    \"max_size\": xxxxx,      (numeric) Maximum number of referrals and of unbeaconed addresses cached\n"
+            "    \"usage\": xxxxx,         (numeric) Estimated number of bytes used\n"
+            "    \"hits\": xxxxx,          (numeric) Lookups answered with a cached referral\n"
+            "    \"missing_hits\": xxxxx,  (numeric) Lookups answered with a cached unbeaconed address\n"
+            "    \"misses\": xxxxx,        (numeric) Lookups that read the referrals database\n"
+            "    \"evictions\": xxxxx,     (numeric) Entries dropped to stay below max_size\n"
             "  }\n"
             "}\n"
             "\nResult (mode \"mallocinfo\"):\n"
@@ -672,6 +698,9 @@ UniValue getmemoryinfo(const JSONRPCRequest& request)
     if (mode == "stats") {
         UniValue obj(UniValue::VOBJ);
         obj.push_back(Pair("locked", RPCLockedMemoryInfo()));
+        if (prefviewcache) {
+            obj.push_back(Pair("referrals", RPCReferralsCacheInfo()));
+        }
         return obj;
     } else if (mode == "mallocinfo") {
 #ifdef HAVE_MALLOC_INFO
@@ -1233,22 +1262,13 @@ UniValue getaddressbalance(const JSONRPCRequest& request)
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid address");
     }
 
-    std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
-
-    for (std::vector<AddressPair>::iterator it = addresses.begin(); it != addresses.end(); it++) {
-        if (!GetAddressIndex((*it).first, (*it).second, false, addressIndex)) {
-            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
-        }
-    }
-
     CAmount balance = 0;
     CAmount received = 0;
 
-    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=addressIndex.begin(); it!=addressIndex.end(); it++) {
-        if (it->second > 0) {
-            received += it->second;
-        }
-        balance += it->second;
+    for (const auto& address : addresses) {
+        const auto totals = GetAddressBalance(address.first, address.second, false);
+        balance += totals.balance;
+        received += totals.received;
     }
 
     UniValue result(UniValue::VOBJ);
@@ -1708,6 +1728,86 @@ UniValue getaddressanv(const JSONRPCRequest& request)
     return total;
 }
 
+static const int DEFAULT_ANV_PAGE_SIZE = 1000;
+static const int MAX_ANV_PAGE_SIZE = 100000;
+
+UniValue getallanvs(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() > 2) {
+        throw std::runtime_error(
+            "getallanvs ( \"after\" count )\n"
+            "\nReturns one page of the ANVs of every address in the referral database,\n"
+            "in address order. Pass the \"next\" field of a result as \"after\" to read\n"
+            "the following page. cs_main is only held while one page is read.\n"
+            "\nArguments:\n"
+            "1. \"after\"      (string, optional) Start after this address, or at the first address if empty\n"
+            "2. count          (numeric, optional, default=" + std::to_string(DEFAULT_ANV_PAGE_SIZE) + ") The most ANVs to return, up to " + std::to_string(MAX_ANV_PAGE_SIZE) + "\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"anvs\": [\n"
+            "    {\n"
+            "      \"address\": \"address\",  (string) The address\n"
+            "      \"anv\": n               (numeric) The Aggregate Network Value in " + CURRENCY_UNIT + "\n"
+            "    }\n"
+            "    ,...\n"
+            "  ],\n"
+            "  \"next\": \"address\"       (string) The \"after\" argument for the next page, null after the last page\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getallanvs", "")
+            + HelpExampleCli("getallanvs", "\"12c6DSiU4Rq3P4ZxziKxzrL5LmMBrzjrJX\" 500")
+            + HelpExampleRpc("getallanvs", "\"12c6DSiU4Rq3P4ZxziKxzrL5LmMBrzjrJX\", 500")
+        );
+    }
+
+    assert(prefviewdb);
+
+    ObserveSafeMode();
+
+    referral::MaybeAddress after;
+    if (!request.params[0].isNull() && !request.params[0].get_str().empty()) {
+        uint160 address;
+        if (!GetUint160(LookupDestination(request.params[0].get_str()), address)) {
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid address");
+        }
+        after = address;
+    }
+
+    int count = DEFAULT_ANV_PAGE_SIZE;
+    if (!request.params[1].isNull()) {
+        count = request.params[1].get_int();
+        if (count < 1 || count > MAX_ANV_PAGE_SIZE) {
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid count");
+        }
+    }
+
+    referral::AddressANVs anvs;
+    bool more;
+    {
+        LOCK(cs_main);
+        more = pog::GetANVsAfter(*prefviewdb, after, count, anvs);
+    }
+
+    UniValue result(UniValue::VOBJ);
+    UniValue entries(UniValue::VARR);
+    for (const auto& anv : anvs) {
+        UniValue entry(UniValue::VOBJ);
+        entry.push_back(Pair("address", CMeritAddress{anv.address_type, anv.address}.ToString()));
+        entry.push_back(Pair("anv", ValueFromAmount(anv.anv)));
+        entries.push_back(entry);
+    }
+    result.push_back(Pair("anvs", entries));
+
+    if (more && !anvs.empty()) {
+        const auto& last = anvs.back();
+        result.push_back(Pair("next", CMeritAddress{last.address_type, last.address}.ToString()));
+    } else {
+        result.push_back(Pair("next", NullUniValue));
+    }
+
+    return result;
+}
+
 static const CRPCCommand commands[] =
 { //  category              name                      actor (function)         argNames
   //  --------------------- ------------------------  -----------------------  ----------
@@ -1731,6 +1831,7 @@ static const CRPCCommand commands[] =
     { "addressindex",       "getaddressbalance",            &getaddressbalance,          {} },
     { "addressindex",       "getaddressrewards",            &getaddressrewards,          {} },
     { "addressindex",       "getaddressanv",                &getaddressanv,              {} },
+    { "addressindex",       "getallanvs",                   &getallanvs,                 {"after","count"} },
 
     /* Blockchain */
     { "blockchain",         "getspentinfo",           &getspentinfo,           {} },
@@ -0,0 +1,121 @@
+// Copyright (c) 2017-2018 The Merit Foundation developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "addressindex.h"
+#include "test/test_merit.h"
+#include "txdb.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(addressindex_tests, BasicTestingSetup)
+
+namespace
+{
+    using KeyActivity = std::vector<std::pair<CAddressIndexKey, CAmount>>;
+
+    const unsigned int KEY_TYPE = 1;
+
+    std::pair<CAddressIndexKey, CAmount> Activity(
+            const uint160& address,
+            int height,
+            const uint256& txhash,
+            size_t index,
+            CAmount amount,
+            bool invite = false)
+    {
+        return std::make_pair(
+                CAddressIndexKey{KEY_TYPE, address, height, 0, txhash, index, amount < 0, invite},
+                amount);
+    }
+
+    void Connect(CBlockTreeDB& db, const KeyActivity& activity, int height)
+    {
+        BOOST_CHECK(db.WriteAddressIndex(activity));
+        BOOST_CHECK(db.WriteAddressBalanceIndex(activity, height));
+    }
+
+    void Disconnect(CBlockTreeDB& db, const KeyActivity& activity, int height)
+    {
+        BOOST_CHECK(db.EraseAddressIndex(activity));
+        BOOST_CHECK(db.EraseAddressBalanceIndex(activity, height));
+    }
+
+    void CheckBalance(
+            CBlockTreeDB& db,
+            const uint160& address,
+            bool invite,
+            CAmount balance,
+            CAmount received,
+            uint64_t txCount,
+            int lastHeight)
+    {
+        CAddressBalanceValue value;
+        BOOST_CHECK(db.ReadAddressBalance(address, KEY_TYPE, invite, value));
+        BOOST_CHECK_EQUAL(value.balance, balance);
+        BOOST_CHECK_EQUAL(value.received, received);
+        BOOST_CHECK_EQUAL(value.txCount, txCount);
+        BOOST_CHECK_EQUAL(value.lastHeight, lastHeight);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(address_balance_index)
+{
+    CBlockTreeDB db(1 << 20, true);
+
+    uint160 address;
+    *address.begin() = 1;
+    uint160 other;
+    *other.begin() = 2;
+
+    const uint256 tx1 = uint256S("01");
+    const uint256 tx2 = uint256S("02");
+    const uint256 tx3 = uint256S("03");
+
+    // two outputs of one transaction, an invite and another address
+    const KeyActivity block1 = {
+        Activity(address, 1, tx1, 0, 50),
+        Activity(address, 1, tx1, 1, 20),
+        Activity(address, 1, tx1, 0, 1, true),
+        Activity(other, 1, tx1, 2, 5),
+    };
+    // spending one output with change back, and an unrelated transaction
+    const KeyActivity block3 = {
+        Activity(address, 3, tx2, 0, -50),
+        Activity(address, 3, tx2, 1, 10),
+        Activity(other, 3, tx3, 0, 7),
+    };
+
+    Connect(db, block1, 1);
+    Connect(db, block3, 3);
+    CheckBalance(db, address, false, 30, 80, 2, 3);
+    CheckBalance(db, address, true, 1, 1, 1, 1);
+    CheckBalance(db, other, false, 12, 12, 2, 3);
+
+    // connecting a block again after an unclean shutdown changes nothing
+    Connect(db, block3, 3);
+    CheckBalance(db, address, false, 30, 80, 2, 3);
+
+    // summing the whole address index gives the same balances
+    BOOST_CHECK(db.BuildAddressBalanceIndex());
+    CheckBalance(db, address, false, 30, 80, 2, 3);
+    CheckBalance(db, address, true, 1, 1, 1, 1);
+    CheckBalance(db, other, false, 12, 12, 2, 3);
+
+    // disconnecting goes back to the previous block with entries
+    Disconnect(db, block3, 3);
+    CheckBalance(db, address, false, 70, 70, 1, 1);
+    CheckBalance(db, other, false, 5, 5, 1, 1);
+
+    Disconnect(db, block3, 3);
+    CheckBalance(db, address, false, 70, 70, 1, 1);
+
+    // an address left without entries has no balance record
+    Disconnect(db, block1, 1);
+    CAddressBalanceValue value;
+    BOOST_CHECK(!db.ReadAddressBalance(address, KEY_TYPE, false, value));
+    BOOST_CHECK(!db.ReadAddressBalance(address, KEY_TYPE, true, value));
+    BOOST_CHECK(!db.ReadAddressBalance(other, KEY_TYPE, false, value));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
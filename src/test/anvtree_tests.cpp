@@ -0,0 +1,205 @@
+// Copyright (c) 2017-2018 The Merit Foundation developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "amount.h"
+#include "pog/anvtree.h"
+#include "pog/select.h"
+#include "refdb.h"
+#include "referrals.h"
+#include "test/test_merit.h"
+#include "uint256.h"
+
+#include <algorithm>
+#include <map>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(anvtree_tests, BasicTestingSetup)
+
+namespace
+{
+    using Entrants = std::map<referral::Address, referral::AddressANV>;
+
+    referral::Address RandomAddress()
+    {
+        const auto hash = InsecureRand256();
+        referral::Address address;
+        std::copy(hash.begin(), hash.begin() + address.size(), address.begin());
+        return address;
+    }
+
+    /**
+     * Plenty of zeros and ties between small ANVs. With tiny ANVs the sampled
+     * amount often lands right on an entrant's cumulative ANV.
+     */
+    CAmount RandomANV(bool tiny)
+    {
+        if (tiny) {
+            return InsecureRandRange(4);
+        }
+
+        switch (InsecureRandRange(4)) {
+            case 0: return 0;
+            case 1: return InsecureRandRange(4) * COIN;
+            case 2: return 1 + InsecureRandRange(1000);
+            default: return 1 + InsecureRandRange(100000 * COIN);
+        }
+    }
+
+    char RandomAddressType()
+    {
+        // Mostly rewardable key and script ids, sometimes a parameterized
+        // script id which can't be rewarded.
+        const char types[] = {1, 1, 2, 2, 3};
+        return types[InsecureRandRange(sizeof(types))];
+    }
+
+    /**
+     * Adds an entrant to the tree the way the referral db does: every entrant
+     * is recorded but only those that can be rewarded go in the tree.
+     */
+    void Insert(pog::AnvTree& tree, Entrants& entrants, const referral::AddressANV& anv)
+    {
+        entrants[anv.address] = anv;
+        if (pog::IsValidAmbassadorDestination(anv.address_type)) {
+            tree.Insert(anv.address_type, anv.address, anv.anv);
+        }
+    }
+
+    /**
+     * The entrants the legacy path samples from: those that can be rewarded,
+     * without the genesis address.
+     */
+    referral::AddressANVs LegacyEntrants(const Entrants& entrants, const referral::Address& genesis)
+    {
+        referral::AddressANVs anvs;
+        for (const auto& e : entrants) {
+            if (!pog::IsValidAmbassadorDestination(e.second.address_type)) {
+                continue;
+            }
+            if (e.first == genesis) {
+                continue;
+            }
+            anvs.push_back(e.second);
+        }
+
+        // The legacy path sorts the entrants in whatever order it lists them.
+        for (size_t i = anvs.size(); i > 1; i--) {
+            std::swap(anvs[i - 1], anvs[InsecureRandRange(i)]);
+        }
+        return anvs;
+    }
+
+    void CheckSameWinners(
+            pog::AnvTree& tree,
+            const Entrants& entrants,
+            const referral::Address& genesis,
+            const referral::ReferralsViewCache& referrals)
+    {
+        tree.Exclude(genesis);
+
+        const auto legacy = LegacyEntrants(entrants, genesis);
+
+        CAmount total = 0;
+        for (const auto& e : legacy) {
+            total += e.anv;
+        }
+
+        BOOST_CHECK_EQUAL(tree.Size(), legacy.size());
+        BOOST_CHECK_EQUAL(tree.Total(), total);
+        BOOST_CHECK_EQUAL(tree.Negatives(), 0U);
+
+        // Sampling needs something to sample.
+        if (total == 0) {
+            return;
+        }
+
+        const int height = 16000 + InsecureRandRange(1000000);
+        const pog::WalletSelector legacy_selector{height, legacy};
+        const pog::WalletSelector tree_selector{tree};
+
+        BOOST_CHECK_EQUAL(tree_selector.Size(), legacy_selector.Size());
+
+        for (int i = 0; i < 20; i++) {
+            const auto hash = InsecureRand256();
+            const auto n = InsecureRandRange(legacy.size() + 1);
+
+            const auto expected = legacy_selector.Select(false, referrals, hash, n);
+            const auto winners = tree_selector.Select(false, referrals, hash, n);
+
+            BOOST_CHECK_EQUAL(winners.size(), expected.size());
+            for (size_t w = 0; w < std::min(winners.size(), expected.size()); w++) {
+                BOOST_CHECK(winners[w].address == expected[w].address);
+                BOOST_CHECK_EQUAL(winners[w].address_type, expected[w].address_type);
+                BOOST_CHECK_EQUAL(winners[w].anv, expected[w].anv);
+            }
+        }
+    }
+}
+
+// From block 16000 the lottery samples from the tree instead of sorting the
+// entrants. Both must pick the same winners or the chain forks.
+BOOST_AUTO_TEST_CASE(tree_selects_legacy_winners)
+{
+    referral::ReferralsViewDB db{1 << 20, true, false, "anvtree_test"};
+    const referral::ReferralsViewCache referrals{&db};
+
+    for (int run = 0; run < 20; run++) {
+        pog::AnvTree tree;
+        Entrants entrants;
+        const auto genesis = RandomAddress();
+        const bool tiny = run % 2 == 0;
+
+        const int initial = InsecureRandRange(200);
+        for (int i = 0; i < initial; i++) {
+            Insert(tree, entrants, {RandomAddressType(), RandomAddress(), RandomANV(tiny)});
+        }
+
+        // The genesis address is an entrant in half the runs, and it may be
+        // added before or after it is first excluded.
+        if (InsecureRandBool()) {
+            Insert(tree, entrants, {1, genesis, RandomANV(tiny)});
+        }
+
+        CheckSameWinners(tree, entrants, genesis, referrals);
+
+        for (int step = 0; step < 300; step++) {
+            const auto op = InsecureRandRange(10);
+
+            if (op < 3 || entrants.empty()) {
+                Insert(tree, entrants, {RandomAddressType(), RandomAddress(), RandomANV(tiny)});
+            } else if (op == 3) {
+                Insert(tree, entrants, {1, genesis, RandomANV(tiny)});
+            } else {
+                auto it = entrants.begin();
+                std::advance(it, InsecureRandRange(entrants.size()));
+                const auto address = it->first;
+
+                if (op < 8) {
+                    const auto anv = RandomANV(tiny);
+                    it->second.anv = anv;
+
+                    const bool in_tree = pog::IsValidAmbassadorDestination(it->second.address_type);
+                    BOOST_CHECK_EQUAL(tree.Update(address, anv), in_tree);
+                } else if (op == 8) {
+                    const bool in_tree = pog::IsValidAmbassadorDestination(it->second.address_type);
+                    entrants.erase(it);
+                    BOOST_CHECK_EQUAL(tree.Erase(address), in_tree);
+                } else {
+                    // Excluding someone else puts the genesis address back
+                    // until it is excluded again.
+                    tree.Exclude(address);
+                }
+            }
+
+            if (step % 25 == 0) {
+                CheckSameWinners(tree, entrants, genesis, referrals);
+            }
+        }
+
+        CheckSameWinners(tree, entrants, genesis, referrals);
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -270,6 +270,87 @@ BOOST_AUTO_TEST_CASE(iterator_ordering)
     }
 }
 
+BOOST_AUTO_TEST_CASE(iterator_prefix)
+{
+    fs::path ph = fs::temp_directory_path() / fs::unique_path();
+    CDBWrapper dbw(ph, (1 << 20), true, false, false);
+    for (char family : {'a', 'b', 'c'}) {
+        for (int x=0x00; x<16; ++x) {
+            BOOST_CHECK(dbw.Write(std::make_pair(family, (uint8_t)x), (uint32_t)x*x));
+        }
+    }
+
+    std::unique_ptr<CDBIterator> it(const_cast<CDBWrapper&>(dbw).NewIterator());
+    for (int seek_start : {0x00, 0x08}) {
+        if (seek_start == 0) {
+            it->SeekPrefix('b');
+        } else {
+            it->SeekPrefix('b', std::make_pair('b', (uint8_t)seek_start));
+        }
+        for (int x=seek_start; x<16; ++x) {
+            std::pair<char, uint8_t> key;
+            uint32_t value;
+            BOOST_CHECK(it->Valid());
+            if (!it->Valid()) // Avoid spurious errors about invalid iterator's key and value in case of failure
+                break;
+            BOOST_CHECK(it->GetKey(key));
+            BOOST_CHECK(it->GetValue(value));
+            BOOST_CHECK_EQUAL(key.first, 'b');
+            BOOST_CHECK_EQUAL(key.second, x);
+            BOOST_CHECK_EQUAL(value, x*x);
+            it->Next();
+        }
+        // The 'c' family follows but is past the prefix
+        BOOST_CHECK(!it->Valid());
+    }
+
+    // A plain seek drops the prefix bound again
+    it->Seek(std::make_pair('b', (uint8_t)0x0f));
+    it->Next();
+    BOOST_CHECK(it->Valid());
+}
+
+BOOST_AUTO_TEST_CASE(iterator_seek_before)
+{
+    fs::path ph = fs::temp_directory_path() / fs::unique_path();
+    CDBWrapper dbw(ph, (1 << 20), true, false, false);
+    for (char family : {'a', 'b'}) {
+        for (int x=0x02; x<16; x+=2) {
+            BOOST_CHECK(dbw.Write(std::make_pair(family, (uint8_t)x), (uint32_t)x*x));
+        }
+    }
+
+    std::unique_ptr<CDBIterator> it(const_cast<CDBWrapper&>(dbw).NewIterator());
+    std::pair<char, uint8_t> key;
+
+    // Both an absent and a present key land on the previous one
+    for (int seek : {0x07, 0x08}) {
+        it->SeekBefore(std::make_pair('a', (uint8_t)seek));
+        BOOST_CHECK(it->Valid());
+        BOOST_CHECK(it->GetKey(key));
+        BOOST_CHECK_EQUAL(key.first, 'a');
+        BOOST_CHECK_EQUAL(key.second, 0x06);
+    }
+
+    // Before the first key of a family is the last key of the one before
+    it->SeekBefore(std::make_pair('b', (uint8_t)0x00));
+    BOOST_CHECK(it->Valid());
+    BOOST_CHECK(it->GetKey(key));
+    BOOST_CHECK_EQUAL(key.first, 'a');
+    BOOST_CHECK_EQUAL(key.second, 0x0e);
+
+    // Past the end of the database is its last key
+    it->SeekBefore(std::make_pair('c', (uint8_t)0x00));
+    BOOST_CHECK(it->Valid());
+    BOOST_CHECK(it->GetKey(key));
+    BOOST_CHECK_EQUAL(key.first, 'b');
+    BOOST_CHECK_EQUAL(key.second, 0x0e);
+
+    // There is nothing before the first key
+    it->SeekBefore(std::make_pair('a', (uint8_t)0x00));
+    BOOST_CHECK(!it->Valid());
+}
+
 struct StringContentsSerializer {
     // Used to make two serialized objects the same while letting them have a different lengths
     // This is a terrible idea
@@ -0,0 +1,355 @@
+// Copyright (c) 2017-2018 The Merit Foundation developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "chainparams.h"
+#include "refdb.h"
+#include "test/test_merit.h"
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <set>
+#include <thread>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(refdb_tests, BasicTestingSetup)
+
+namespace
+{
+    referral::Address MakeAddress(int n)
+    {
+        referral::Address address;
+        *address.begin() = 1;
+        WriteLE32(address.begin() + 1, n);
+        return address;
+    }
+
+    referral::Referral MakeReferral(int n, const referral::Address& parent, char address_type = 1)
+    {
+        std::vector<unsigned char> pubkey(33, n);
+        pubkey[0] = 0x02;
+        return referral::MutableReferral{address_type, MakeAddress(n), CPubKey{pubkey.begin(), pubkey.end()}, parent};
+    }
+
+    /**
+     * Gives tests the wrapped DB to read and write records as they are stored
+     * on disk.
+     */
+    class RawReferralsViewDB : public referral::ReferralsViewDB
+    {
+    public:
+        using referral::ReferralsViewDB::ReferralsViewDB;
+
+        CDBWrapper& Raw() { return m_db; }
+    };
+
+    // On disk formats, as written by ReferralsViewDB.
+    const char DB_CHILDREN = 'c';
+    const char DB_ANV = 'a';
+    using RawANV = std::tuple<char, referral::Address, std::pair<CAmount, CAmount>>;
+    using RawChildKey = std::pair<char, std::pair<referral::Address, referral::Address>>;
+
+    /**
+     * The ANVs as stored, exact rationals rather than the rounded amounts
+     * GetAllANVs returns. Pending changes have to be flushed first.
+     */
+    std::vector<RawANV> GetRawANVs(RawReferralsViewDB& db)
+    {
+        std::vector<RawANV> anvs;
+        std::unique_ptr<CDBIterator> iter{db.Raw().NewIterator()};
+        for (iter->SeekPrefix(DB_ANV); iter->Valid(); iter->Next()) {
+            RawANV anv;
+            BOOST_CHECK(iter->GetValue(anv));
+            anvs.push_back(anv);
+        }
+        return anvs;
+    }
+
+    void CheckSameANVs(RawReferralsViewDB& expected, RawReferralsViewDB& db)
+    {
+        BOOST_CHECK(expected.Flush(uint256{}));
+        BOOST_CHECK(db.Flush(uint256{}));
+
+        const auto expected_raw = GetRawANVs(expected);
+        const auto raw = GetRawANVs(db);
+        BOOST_CHECK(!raw.empty());
+        BOOST_CHECK(raw == expected_raw);
+
+        const auto expected_anvs = expected.GetAllANVs();
+        const auto anvs = db.GetAllANVs();
+        BOOST_CHECK_EQUAL(anvs.size(), expected_anvs.size());
+        for (size_t i = 0; i < std::min(anvs.size(), expected_anvs.size()); i++) {
+            BOOST_CHECK(anvs[i].address == expected_anvs[i].address);
+            BOOST_CHECK_EQUAL(anvs[i].address_type, expected_anvs[i].address_type);
+            BOOST_CHECK_EQUAL(anvs[i].anv, expected_anvs[i].anv);
+        }
+
+        // The lottery keeps its own copy of the entrants' ANVs.
+        const auto& params = Params().GetConsensus();
+        referral::AddressANVs expected_entrants;
+        referral::AddressANVs entrants;
+        expected.GetAllRewardableANVs(params, 20000, expected_entrants);
+        db.GetAllRewardableANVs(params, 20000, entrants);
+
+        BOOST_CHECK(!entrants.empty());
+        BOOST_CHECK_EQUAL(entrants.size(), expected_entrants.size());
+        for (size_t i = 0; i < std::min(entrants.size(), expected_entrants.size()); i++) {
+            BOOST_CHECK(entrants[i].address == expected_entrants[i].address);
+            BOOST_CHECK_EQUAL(entrants[i].anv, expected_entrants[i].anv);
+        }
+
+        const auto* expected_tree = expected.GetRewardableANVTree(params.genesis_address);
+        const auto* tree = db.GetRewardableANVTree(params.genesis_address);
+        BOOST_REQUIRE(expected_tree && tree);
+        BOOST_CHECK_EQUAL(tree->Size(), expected_tree->Size());
+        BOOST_CHECK_EQUAL(tree->Total(), expected_tree->Total());
+    }
+}
+
+// Lookups made without cs_main, as RPC and the wallet do, run while blocks
+// are connected and the pending changes are flushed.
+BOOST_AUTO_TEST_CASE(refdb_read_during_flush)
+{
+    referral::ReferralsViewDB db{1 << 20, true, false, "refdb_test"};
+
+    const int count = 2000;
+    const auto root = MakeReferral(0, referral::Address{});
+    BOOST_CHECK(db.InsertReferral(root, true, false));
+
+    // Boost.Test checks are not thread safe, so the writer only records
+    // whether its calls succeeded
+    std::atomic<int> inserted{0};
+    bool writes_ok = true;
+    std::thread writer{[&] {
+        for (int n = 1; n <= count; n++) {
+            writes_ok &= db.InsertReferral(MakeReferral(n, root.GetAddress()), false, false);
+            inserted = n;
+            if (n % 16 == 0) {
+                writes_ok &= db.Flush(uint256{});
+            }
+        }
+        writes_ok &= db.Flush(uint256{});
+    }};
+
+    bool all_found = true;
+    for (int seen = 0; seen < count; ) {
+        seen = inserted;
+        const auto children = db.GetChildren(root.GetAddress());
+        all_found &= children.size() >= static_cast<size_t>(seen);
+        for (int n = std::max(1, seen - 16); n <= seen; n++) {
+            const auto address = MakeReferral(n, root.GetAddress()).GetAddress();
+            all_found &= db.Exists(address) && static_cast<bool>(db.GetReferral(address));
+        }
+    }
+    writer.join();
+
+    BOOST_CHECK(writes_ok);
+    BOOST_CHECK(all_found);
+    BOOST_CHECK_EQUAL(db.GetChildren(root.GetAddress()).size(), static_cast<size_t>(count));
+}
+
+// Connecting and disconnecting blocks applies all their ANV changes at once,
+// which must end up exactly where applying them one at a time does.
+BOOST_AUTO_TEST_CASE(refdb_update_anvs_matches_update_anv)
+{
+    RawReferralsViewDB sequential{1 << 20, true, false, "refdb_anv_sequential"};
+    RawReferralsViewDB batched{1 << 20, true, false, "refdb_anv_batched"};
+
+    // Long chains hanging off random referrals. Every level halves the
+    // change, so the depth is kept well within the 64 bit denominators.
+    const int count = 500;
+    const size_t max_depth = 24;
+    std::vector<referral::Referral> referrals;
+    std::vector<size_t> depths;
+    for (int n = 0; n < count; n++) {
+        referral::Address parent;
+        size_t depth = 0;
+        if (n > 0) {
+            size_t parent_idx = InsecureRandRange(4) != 0 ? n - 1 : InsecureRandRange(n);
+            while (depths[parent_idx] >= max_depth) {
+                parent_idx = InsecureRandRange(n);
+            }
+            parent = referrals[parent_idx].GetAddress();
+            depth = depths[parent_idx] + 1;
+        }
+
+        // Some referrals can't be rewarded and never enter the lottery.
+        const char address_type = InsecureRandRange(5) == 0 ? 3 : 1 + InsecureRandRange(2);
+        referrals.push_back(MakeReferral(n, parent, address_type));
+        depths.push_back(depth);
+
+        BOOST_CHECK(sequential.InsertReferral(referrals.back(), n == 0, false));
+        BOOST_CHECK(batched.InsertReferral(referrals.back(), n == 0, false));
+    }
+
+    const auto random_change = [&referrals]() {
+        const auto& ref = referrals[InsecureRandRange(referrals.size())];
+        const CAmount amount = 1 + InsecureRandRange(1000000);
+        return referral::ANVChange{ref.addressType, ref.GetAddress(), InsecureRandRange(4) == 0 ? -amount : amount};
+    };
+
+    for (int block = 0; block < 20; block++) {
+        referral::ANVChanges changes;
+        for (int c = 0; c < 100; c++) {
+            changes.push_back(random_change());
+        }
+
+        // A debit and credit of the same address that cancel out, one that
+        // doesn't, and a change to the root.
+        const auto change = random_change();
+        changes.push_back(change);
+        changes.emplace_back(std::get<0>(change), std::get<1>(change), -std::get<2>(change));
+        changes.push_back(random_change());
+        changes.emplace_back(std::get<0>(changes.back()), std::get<1>(changes.back()), -2 * std::get<2>(changes.back()));
+        changes.emplace_back(referrals[0].addressType, referrals[0].GetAddress(), 1 + InsecureRandRange(1000000));
+
+        for (size_t i = changes.size(); i > 1; i--) {
+            std::swap(changes[i - 1], changes[InsecureRandRange(i)]);
+        }
+
+        for (const auto& c : changes) {
+            BOOST_CHECK(sequential.UpdateANV(std::get<0>(c), std::get<1>(c), std::get<2>(c)));
+        }
+        BOOST_CHECK(batched.UpdateANVs(changes));
+
+        // Once everyone has an ANV, offer them all to a lottery big enough
+        // to take them, so later changes also update its ANVs.
+        if (block == 0) {
+            for (const auto& ref : referrals) {
+                const auto rand_value = InsecureRand256();
+                referral::LotteryUndos undos;
+                BOOST_CHECK(sequential.AddAddressToLottery(20000, rand_value, ref.addressType, ref.GetAddress(), count, undos));
+                BOOST_CHECK(batched.AddAddressToLottery(20000, rand_value, ref.addressType, ref.GetAddress(), count, undos));
+            }
+        }
+
+        CheckSameANVs(sequential, batched);
+    }
+}
+
+// The ANV rationals are not checked for overflow. Deep chains and ANVs near
+// the money supply wrap them, and must wrap the same way either way.
+BOOST_AUTO_TEST_CASE(refdb_update_anvs_deep_chain)
+{
+    RawReferralsViewDB sequential{1 << 20, true, false, "refdb_deep_sequential"};
+    RawReferralsViewDB batched{1 << 20, true, false, "refdb_deep_batched"};
+
+    const int depth = 80;
+    std::vector<referral::Referral> chain;
+    for (int n = 0; n < depth; n++) {
+        chain.push_back(MakeReferral(n, n == 0 ? referral::Address{} : chain.back().GetAddress()));
+        BOOST_CHECK(sequential.InsertReferral(chain.back(), n == 0, false));
+        BOOST_CHECK(batched.InsertReferral(chain.back(), n == 0, false));
+    }
+
+    for (const auto& ref : chain) {
+        const auto rand_value = InsecureRand256();
+        referral::LotteryUndos undos;
+        BOOST_CHECK(sequential.AddAddressToLottery(20000, rand_value, ref.addressType, ref.GetAddress(), depth, undos));
+        BOOST_CHECK(batched.AddAddressToLottery(20000, rand_value, ref.addressType, ref.GetAddress(), depth, undos));
+    }
+
+    // Changes of whole multiples of 2^20 satoshis keep the denominators of
+    // even the deepest changes within 64 bits, while the numerators of the
+    // ancestors wrap.
+    const CAmount unit = 1 << 20;
+    for (int block = 0; block < 10; block++) {
+        referral::ANVChanges changes;
+        for (int c = 0; c < 20; c++) {
+            const auto& ref = chain[InsecureRandRange(chain.size())];
+            const CAmount amount = (MAX_MONEY - InsecureRandRange(MAX_MONEY / 10)) / unit * unit;
+            changes.emplace_back(ref.addressType, ref.GetAddress(), InsecureRandBool() ? -amount : amount);
+        }
+        changes.emplace_back(chain.back().addressType, chain.back().GetAddress(), MAX_MONEY / unit * unit);
+        changes.emplace_back(chain.back().addressType, chain.back().GetAddress(), -(MAX_MONEY / unit * unit));
+
+        for (const auto& c : changes) {
+            BOOST_CHECK(sequential.UpdateANV(std::get<0>(c), std::get<1>(c), std::get<2>(c)));
+        }
+        BOOST_CHECK(batched.UpdateANVs(changes));
+
+        CheckSameANVs(sequential, batched);
+    }
+
+    // An odd change more than 62 levels below an ancestor can't be halved
+    // for it without overflowing the denominator, which both refuse.
+    const referral::ANVChanges odd{referral::ANVChange{chain.back().addressType, chain.back().GetAddress(), MAX_MONEY}};
+    BOOST_CHECK_THROW(sequential.UpdateANV(std::get<0>(odd[0]), std::get<1>(odd[0]), std::get<2>(odd[0])), std::exception);
+    BOOST_CHECK_THROW(batched.UpdateANVs(odd), std::exception);
+}
+
+// Older versions stored the children of a referral in one vector. The upgrade
+// moves every child to its own key on existing nodes.
+BOOST_AUTO_TEST_CASE(refdb_upgrade_children)
+{
+    RawReferralsViewDB db{1 << 20, true, false, "refdb_upgrade"};
+
+    // Enough children that the upgrade writes more than one 16 MiB batch.
+    const int parents = 40;
+    const int children_per_parent = 10000;
+    std::map<referral::Address, std::set<referral::Address>> expected;
+
+    int n = 0;
+    for (int p = 0; p < parents; p++) {
+        const auto parent = MakeAddress(n++);
+        referral::ChildAddresses children;
+        for (int c = 0; c < children_per_parent; c++) {
+            children.push_back(MakeAddress(n++));
+        }
+        BOOST_CHECK(db.Raw().Write(std::make_pair(DB_CHILDREN, parent), children));
+        expected[parent].insert(children.begin(), children.end());
+    }
+
+    // A parent whose children were already written under their own keys,
+    // with an old record listing one of them and one that isn't.
+    const auto root = MakeReferral(n++, referral::Address{});
+    BOOST_CHECK(db.InsertReferral(root, true, false));
+    for (int c = 0; c < 10; c++) {
+        const auto child = MakeReferral(n++, root.GetAddress());
+        BOOST_CHECK(db.InsertReferral(child, false, false));
+        expected[root.GetAddress()].insert(child.GetAddress());
+    }
+    BOOST_CHECK(db.Flush(uint256{}));
+
+    const referral::ChildAddresses old_children{
+        *expected[root.GetAddress()].begin(),
+        MakeAddress(n++)};
+    BOOST_CHECK(db.Raw().Write(std::make_pair(DB_CHILDREN, root.GetAddress()), old_children));
+    expected[root.GetAddress()].insert(old_children.begin(), old_children.end());
+
+    BOOST_CHECK(db.Upgrade());
+
+    const auto check_children = [&]() {
+        for (const auto& e : expected) {
+            const auto children = db.GetChildren(e.first);
+            BOOST_CHECK_EQUAL(children.size(), e.second.size());
+            BOOST_CHECK(std::set<referral::Address>(children.begin(), children.end()) == e.second);
+            BOOST_CHECK(!db.Raw().Exists(std::make_pair(DB_CHILDREN, e.first)));
+        }
+    };
+    check_children();
+
+    // Nothing but the children's own keys is left.
+    size_t keys = 0;
+    std::unique_ptr<CDBIterator> iter{db.Raw().NewIterator()};
+    for (iter->SeekPrefix(DB_CHILDREN); iter->Valid(); iter->Next()) {
+        RawChildKey key;
+        BOOST_CHECK(iter->GetKey(key));
+        BOOST_CHECK_EQUAL(iter->GetValueSize(), 1U);
+        keys++;
+    }
+    BOOST_CHECK_EQUAL(keys, parents * children_per_parent + expected[root.GetAddress()].size());
+
+    // Upgrading again leaves even a stray old record alone.
+    const auto stray = MakeAddress(n++);
+    const referral::ChildAddresses stray_children{MakeAddress(n++)};
+    BOOST_CHECK(db.Raw().Write(std::make_pair(DB_CHILDREN, stray), stray_children));
+
+    BOOST_CHECK(db.Upgrade());
+    BOOST_CHECK(db.Raw().Exists(std::make_pair(DB_CHILDREN, stray)));
+    check_children();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -3,11 +3,13 @@
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include "cuckoo/cycle.h"
 #include "serialize.h"
 #include "streams.h"
 #include "hash.h"
 #include "test/test_merit.h"
 
+#include <set>
 #include <stdint.h>
 
 #include <boost/test/unit_test.hpp>
@@ -366,4 +368,37 @@ BOOST_AUTO_TEST_CASE(class_methods)
     BOOST_CHECK(methodtest3 == methodtest4);
 }
 
+BOOST_AUTO_TEST_CASE(cuckoo_cycle)
+{
+    std::set<uint32_t> set;
+    for (uint32_t i = 0; i < cuckoo::CYCLE_INLINE_SIZE; i++) {
+        set.insert(i * 7919 + 3);
+    }
+    const cuckoo::Cycle cycle{set.begin(), set.end()};
+
+    // same bytes as the std::set cycles used to be stored in
+    CDataStream ssSet(SER_DISK, PROTOCOL_VERSION);
+    CDataStream ssCycle(SER_DISK, PROTOCOL_VERSION);
+    ssSet << set;
+    ssCycle << cycle;
+    BOOST_CHECK(ssSet.str() == ssCycle.str());
+    BOOST_CHECK(SerializeHash(set) == SerializeHash(cycle));
+
+    cuckoo::Cycle cycle2;
+    ssCycle >> cycle2;
+    BOOST_CHECK(cycle2 == cycle);
+
+    // unordered and repeated nonces read as a std::set would
+    std::vector<uint32_t> nonces{5, 1, 3, 1, 5};
+    CDataStream ssNonces(SER_DISK, PROTOCOL_VERSION);
+    ssNonces << nonces;
+    CDataStream ssNonces2{ssNonces};
+    ssNonces >> set;
+    ssNonces2 >> cycle2;
+    BOOST_CHECK(std::equal(set.begin(), set.end(), cycle2.begin()));
+    BOOST_CHECK_EQUAL(cycle2.size(), 3U);
+
+    BOOST_CHECK(cuckoo::Cycle({3, 1, 2}) == cuckoo::Cycle({1, 2, 3}));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,91 @@
+// Copyright (c) 2017-2018 The Merit Foundation developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "cuckoo/solver_pool.h"
+#include "test/test_merit.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(solver_pool_tests, BasicTestingSetup)
+
+static const uint8_t EDGE_BITS = 16;
+static const uint8_t PROOF_SIZE = 42;
+
+BOOST_AUTO_TEST_CASE(solver_pool_reuse)
+{
+    cuckoo::ClearSolverPool();
+    const auto start = cuckoo::GetSolverPoolStats();
+
+    const cuckoo::Solver* first;
+    {
+        auto solver = cuckoo::AcquireSolver(EDGE_BITS, PROOF_SIZE, 1);
+        BOOST_CHECK(solver);
+        BOOST_CHECK_EQUAL(solver->EdgeBits(), EDGE_BITS);
+        first = &*solver;
+
+        const auto stats = cuckoo::GetSolverPoolStats();
+        BOOST_CHECK_EQUAL(stats.created, start.created + 1);
+        BOOST_CHECK_EQUAL(stats.inUse, start.inUse + 1);
+        BOOST_CHECK_EQUAL(stats.idle, 0U);
+    }
+
+    auto stats = cuckoo::GetSolverPoolStats();
+    BOOST_CHECK_EQUAL(stats.inUse, start.inUse);
+    BOOST_CHECK_EQUAL(stats.idle, 1U);
+    BOOST_CHECK(stats.idleMemory > 0);
+
+    // a solver made with other arguments is not handed out
+    {
+        auto solver = cuckoo::AcquireSolver(EDGE_BITS, PROOF_SIZE, 2);
+        BOOST_CHECK(&*solver != first);
+        BOOST_CHECK_EQUAL(cuckoo::GetSolverPoolStats().created, start.created + 2);
+    }
+
+    auto solver = cuckoo::AcquireSolver(EDGE_BITS, PROOF_SIZE, 1);
+    BOOST_CHECK(&*solver == first);
+    stats = cuckoo::GetSolverPoolStats();
+    BOOST_CHECK_EQUAL(stats.reused, start.reused + 1);
+    BOOST_CHECK_EQUAL(stats.idle, 1U);
+
+    solver.reset();
+    BOOST_CHECK(!solver);
+    BOOST_CHECK_EQUAL(cuckoo::GetSolverPoolStats().idle, 2U);
+
+    cuckoo::ClearSolverPool();
+    stats = cuckoo::GetSolverPoolStats();
+    BOOST_CHECK_EQUAL(stats.idle, 0U);
+    BOOST_CHECK_EQUAL(stats.idleMemory, 0U);
+}
+
+BOOST_AUTO_TEST_CASE(solver_pool_limit)
+{
+    cuckoo::ClearSolverPool();
+    const auto start = cuckoo::GetSolverPoolStats();
+
+    // a solver larger than the limit is freed once returned
+    cuckoo::SetSolverPoolLimit(0);
+    cuckoo::AcquireSolver(EDGE_BITS, PROOF_SIZE, 1).reset();
+    auto stats = cuckoo::GetSolverPoolStats();
+    BOOST_CHECK_EQUAL(stats.idle, 0U);
+    BOOST_CHECK_EQUAL(stats.evicted, start.evicted + 1);
+
+    // lowering the limit frees the least recently returned solvers
+    cuckoo::SetSolverPoolLimit(cuckoo::DEFAULT_SOLVER_POOL_LIMIT);
+    {
+        auto a = cuckoo::AcquireSolver(EDGE_BITS, PROOF_SIZE, 1);
+        auto b = cuckoo::AcquireSolver(EDGE_BITS, PROOF_SIZE, 1);
+    }
+    stats = cuckoo::GetSolverPoolStats();
+    BOOST_CHECK_EQUAL(stats.idle, 2U);
+
+    cuckoo::SetSolverPoolLimit(stats.idleMemory / 2);
+    stats = cuckoo::GetSolverPoolStats();
+    BOOST_CHECK_EQUAL(stats.idle, 1U);
+    BOOST_CHECK_EQUAL(stats.evicted, start.evicted + 2);
+
+    cuckoo::SetSolverPoolLimit(cuckoo::DEFAULT_SOLVER_POOL_LIMIT);
+    cuckoo::ClearSolverPool();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
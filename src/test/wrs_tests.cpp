@@ -0,0 +1,83 @@
+// Copyright (c) 2017-2018 The Merit Foundation developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "amount.h"
+#include "pog/wrs.h"
+#include "test/test_merit.h"
+#include "uint256.h"
+
+#include <cmath>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(wrs_tests, BasicTestingSetup)
+
+static CAmount RandomANV()
+{
+    // Mostly small ANVs with the occasional huge one, up to the money supply.
+    return InsecureRandBool() ?
+        1 + InsecureRandRange(100000 * COIN) :
+        1 + InsecureRandRange(MAX_MONEY);
+}
+
+// Returns true if the estimate settled the comparison on its own.
+static bool CheckEstimate(const uint256& rand_value, CAmount anv, const pog::WeightedKey& bound_key)
+{
+    const auto estimate = pog::WeightedKeyEstimate(rand_value, anv);
+    if (!pog::KeyEstimateCannotExceed(estimate, static_cast<double>(bound_key))) {
+        return false;
+    }
+
+    const auto key = pog::WeightedKeyForSampling(rand_value, anv);
+    BOOST_CHECK(!(bound_key < key));
+    return true;
+}
+
+BOOST_AUTO_TEST_CASE(estimate_matches_key)
+{
+    for (int i = 0; i < 10000; i++) {
+        const auto rand_value = InsecureRand256();
+        const auto anv = RandomANV();
+
+        const auto key = static_cast<double>(pog::WeightedKeyForSampling(rand_value, anv));
+        const auto estimate = pog::WeightedKeyEstimate(rand_value, anv);
+        BOOST_CHECK(estimate <= 0);
+        BOOST_CHECK(std::fabs(estimate - key) <= std::fabs(key) * 1e-14);
+    }
+
+    // Keys of entrants without ANV are the smallest possible key.
+    const auto rand_value = InsecureRand256();
+    BOOST_CHECK_EQUAL(pog::WeightedKeyEstimate(rand_value, 0),
+            static_cast<double>(pog::WeightedKeyForSampling(rand_value, 0)));
+}
+
+BOOST_AUTO_TEST_CASE(estimate_never_disagrees)
+{
+    int settled = 0;
+    const int runs = 10000;
+    for (int i = 0; i < runs; i++) {
+        const auto rand_value = InsecureRand256();
+        const auto anv = RandomANV();
+
+        // Unrelated keys, most of which the estimate settles.
+        if (CheckEstimate(rand_value, anv, pog::WeightedKeyForSampling(InsecureRand256(), RandomANV()))) {
+            settled++;
+        }
+
+        // Near ties between neighbouring ANVs, ties and the extremes.
+        const auto key = pog::WeightedKeyForSampling(rand_value, anv);
+        CheckEstimate(rand_value, anv, key);
+        CheckEstimate(rand_value, anv + 1, key);
+        CheckEstimate(rand_value, anv, pog::WeightedKeyForSampling(rand_value, anv + 1));
+        CheckEstimate(rand_value, 0, key);
+        CheckEstimate(rand_value, anv, pog::WeightedKeyForSampling(rand_value, 0));
+        CheckEstimate(rand_value, anv, pog::WeightedKey{0});
+    }
+
+    // Half of the random keys are smaller than the other one and almost all
+    // of those should be turned away without the exact key.
+    BOOST_CHECK(settled > runs * 4 / 10);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -15,8 +15,10 @@
 #include "util.h"
 #include "ui_interface.h"
 #include "init.h"
-#include "cuckoo/miner.h"
+#include "pog/invitebuffer.h"
 
+#include <map>
+#include <set>
 #include <stdint.h>
 
 #include <boost/thread.hpp>
@@ -27,11 +29,13 @@ static const char DB_BLOCK_FILES = 'f';
 static const char DB_TXINDEX = 't';
 static const char DB_ADDRESSINDEX = 'a';
 static const char DB_ADDRESSUNSPENTINDEX = 'u';
+static const char DB_ADDRESSBALANCE = 'A';
 static const char DB_TIMESTAMPINDEX = 's';
 static const char DB_BLOCKHASHINDEX = 'z';
 static const char DB_SPENTINDEX = 'p';
 static const char DB_BLOCK_INDEX = 'b';
 static const char DB_REFERRALSINDEX = 'r';
+static const char DB_INVITESTATS = 'I';
 
 static const char DB_BEST_BLOCK = 'B';
 static const char DB_HEAD_BLOCKS = 'H';
@@ -42,6 +46,35 @@ static const char DB_LAST_BLOCK = 'l';
 namespace {
     const int VERIFY_SAMPLE_COUNT = 10;
 
+//type is encoded with greater than 10 if it is an invite
+unsigned int EncodedAddressType(const CAddressIndexKey& key)
+{
+    return key.invite ? key.type + 10 : key.type;
+}
+
+// What one block's address index entries add to the balance of each address
+struct AddressBalanceDelta {
+    CAmount balance = 0;
+    CAmount received = 0;
+    std::set<uint256> txs;
+};
+
+using AddressBalanceDeltas = std::map<std::pair<unsigned int, uint160>, AddressBalanceDelta>;
+
+AddressBalanceDeltas SumAddressIndex(const std::vector<std::pair<CAddressIndexKey, CAmount>>& vect)
+{
+    AddressBalanceDeltas deltas;
+    for (const auto& addr : vect) {
+        auto& delta = deltas[std::make_pair(EncodedAddressType(addr.first), addr.first.hashBytes)];
+        delta.balance += addr.second;
+        if (addr.second > 0) {
+            delta.received += addr.second;
+        }
+        delta.txs.insert(addr.first.txhash);
+    }
+    return deltas;
+}
+
 struct CoinEntry {
     COutPoint* outpoint;
     char key;
@@ -375,6 +408,151 @@ bool CBlockTreeDB::ReadAddressIndex(
     return true;
 }
 
+bool CBlockTreeDB::ReadAddressBalance(
+        uint160 addressHash,
+        unsigned int type,
+        bool invite,
+        CAddressBalanceValue &value) {
+
+    const unsigned int encoded_type = invite ? type + 10 : type;
+    return Read(std::make_pair(DB_ADDRESSBALANCE, CAddressIndexIteratorKey(encoded_type, addressHash)), value);
+}
+
+int CBlockTreeDB::ReadLastAddressIndexHeight(const CAddressIndexIteratorKey &address, int height) {
+    boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
+    pcursor->SeekBefore(std::make_pair(DB_ADDRESSINDEX, CAddressIndexIteratorHeightKey(address.type, address.hashBytes, height)));
+
+    std::pair<char,CAddressIndexKey> key;
+    if (pcursor->Valid() &&
+            pcursor->GetKey(key) &&
+            key.first == DB_ADDRESSINDEX &&
+            EncodedAddressType(key.second) == address.type &&
+            key.second.hashBytes == address.hashBytes) {
+        return key.second.blockHeight;
+    }
+
+    return -1;
+}
+
+bool CBlockTreeDB::WriteAddressBalanceIndex(const std::vector<std::pair<CAddressIndexKey, CAmount > >&vect, int height) {
+    CDBBatch batch(*this);
+    for (const auto& delta : SumAddressIndex(vect)) {
+        const auto key = std::make_pair(DB_ADDRESSBALANCE, CAddressIndexIteratorKey(delta.first.first, delta.first.second));
+
+        CAddressBalanceValue value;
+        if (!Read(key, value)) {
+            value.SetNull();
+        }
+
+        // The address index is written before the chainstate is flushed, so
+        // blocks connected again after an unclean shutdown are already in.
+        if (value.lastHeight >= height) {
+            continue;
+        }
+
+        value.balance += delta.second.balance;
+        value.received += delta.second.received;
+        value.txCount += delta.second.txs.size();
+        value.lastHeight = height;
+        batch.Write(key, value);
+    }
+    return WriteBatch(batch);
+}
+
+bool CBlockTreeDB::EraseAddressBalanceIndex(const std::vector<std::pair<CAddressIndexKey, CAmount > >&vect, int height) {
+    CDBBatch batch(*this);
+    for (const auto& delta : SumAddressIndex(vect)) {
+        const CAddressIndexIteratorKey address(delta.first.first, delta.first.second);
+        const auto key = std::make_pair(DB_ADDRESSBALANCE, address);
+
+        // Skip blocks which were never added or were already taken out
+        CAddressBalanceValue value;
+        if (!Read(key, value) || value.lastHeight != height) {
+            continue;
+        }
+
+        value.balance -= delta.second.balance;
+        value.received -= delta.second.received;
+        value.txCount -= std::min<uint64_t>(value.txCount, delta.second.txs.size());
+
+        if (value.IsNull()) {
+            batch.Erase(key);
+        } else {
+            value.lastHeight = ReadLastAddressIndexHeight(address, height);
+            batch.Write(key, value);
+        }
+    }
+    return WriteBatch(batch);
+}
+
+bool CBlockTreeDB::BuildAddressBalanceIndex() {
+    const size_t batch_size = 1 << 24;
+    CDBBatch batch(*this);
+
+    // Drop the totals an interrupted build left behind
+    boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
+    pcursor->SeekPrefix(DB_ADDRESSBALANCE);
+    while (pcursor->Valid()) {
+        boost::this_thread::interruption_point();
+        std::pair<char,CAddressIndexIteratorKey> key;
+        if (!pcursor->GetKey(key)) {
+            return error("%s: cannot parse address balance key", __func__);
+        }
+        batch.Erase(key);
+        if (batch.SizeEstimate() > batch_size) {
+            WriteBatch(batch);
+            batch.Clear();
+        }
+        pcursor->Next();
+    }
+
+    // Entries are ordered by address, then by height and transaction, so
+    // each address is summed in one run and its transactions are adjacent.
+    CAddressIndexIteratorKey address;
+    CAddressBalanceValue value;
+    uint256 last_txhash;
+    pcursor->SeekPrefix(DB_ADDRESSINDEX);
+    while (pcursor->Valid()) {
+        boost::this_thread::interruption_point();
+        std::pair<char,CAddressIndexKey> key;
+        CAmount amount;
+        if (!pcursor->GetKey(key) || !pcursor->GetValue(amount)) {
+            return error("%s: cannot parse address index entry", __func__);
+        }
+        const CAddressIndexKey& entry = key.second;
+
+        if (!value.IsNull() &&
+                (EncodedAddressType(entry) != address.type || entry.hashBytes != address.hashBytes)) {
+            batch.Write(std::make_pair(DB_ADDRESSBALANCE, address), value);
+            value.SetNull();
+            if (batch.SizeEstimate() > batch_size) {
+                WriteBatch(batch);
+                batch.Clear();
+            }
+        }
+
+        if (value.IsNull()) {
+            address = CAddressIndexIteratorKey(EncodedAddressType(entry), entry.hashBytes);
+        }
+        if (value.IsNull() || entry.blockHeight != value.lastHeight || entry.txhash != last_txhash) {
+            value.txCount++;
+        }
+        value.balance += amount;
+        if (amount > 0) {
+            value.received += amount;
+        }
+        value.lastHeight = entry.blockHeight;
+        last_txhash = entry.txhash;
+
+        pcursor->Next();
+    }
+
+    if (!value.IsNull()) {
+        batch.Write(std::make_pair(DB_ADDRESSBALANCE, address), value);
+    }
+    return WriteBatch(batch);
+}
+
 bool CBlockTreeDB::WriteTimestampIndex(const CTimestampIndexKey &timestampIndex) {
     CDBBatch batch(*this);
     batch.Write(std::make_pair(DB_TIMESTAMPINDEX, timestampIndex), 0);
@@ -423,6 +601,14 @@ bool CBlockTreeDB::ReadTimestampBlockIndex(const uint256 &hash, unsigned int &lt
     return true;
 }
 
+bool CBlockTreeDB::WriteInviteStats(const uint256 &hash, const pog::InviteStats &stats) {
+    return Write(std::make_pair(DB_INVITESTATS, hash), stats);
+}
+
+bool CBlockTreeDB::ReadInviteStats(const uint256 &hash, pog::InviteStats &stats) {
+    return Read(std::make_pair(DB_INVITESTATS, hash), stats);
+}
+
 bool CBlockTreeDB::WriteFlag(const std::string &name, bool fValue) {
     return Write(std::make_pair(DB_FLAG, name), fValue ? '1' : '0');
 }
@@ -437,8 +623,8 @@ bool CBlockTreeDB::ReadFlag(const std::string &name, bool &fValue) {
 }
 
 bool CBlockTreeDB::LoadBlockIndexGuts(
-        const Consensus::Params& consensusParams,
-        std::function<CBlockIndex*(const uint256&)> insertBlockIndex)
+        std::function<CBlockIndex*(const uint256&)> insertBlockIndex,
+        std::function<bool(const CBlockIndex*)> checkBlockIndex)
 {
     std::unique_ptr<CDBIterator> pcursor(NewIterator());
 
@@ -468,13 +654,8 @@ bool CBlockTreeDB::LoadBlockIndexGuts(
                 pindexNew->nTx            = diskindex.nTx;
                 pindexNew->sCycle       = diskindex.sCycle;
 
-                if (!cuckoo::VerifyProofOfWork(
-                        pindexNew->GetBlockHash(),
-                        pindexNew->nBits,
-                        pindexNew->nEdgeBits,
-                        pindexNew->sCycle,
-                        consensusParams)) {
-                    return error("%s: CheckProofOfWork failed: %s", __func__, pindexNew->ToString());
+                if (!checkBlockIndex(pindexNew)) {
+                    return false;
                 }
 
                 pcursor->Next();
@@ -24,6 +24,11 @@ class CCoinsViewDBCursor;
 class uint256;
 class CChainParams;
 
+namespace pog
+{
+    struct InviteStats;
+}
+
 //! Compensate for extra memory peak (x1.5-x1.9) at flush time.
 static constexpr int DB_PEAK_USAGE_FACTOR = 2;
 //! No need to periodic flush if at least this much space still available.
@@ -147,19 +152,45 @@ public:
             std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex,
             int start = 0,
             int end = 0);
+    bool ReadAddressBalance(
+            uint160 addressHash,
+            unsigned int type,
+            bool invite,
+            CAddressBalanceValue &value);
+    /**
+     * Add the address index entries of the block at height to the balances
+     * of their addresses, or take them out when it is disconnected. Each is
+     * a no-op for addresses whose balance already has the block added or
+     * taken out, so either may be repeated.
+     */
+    bool WriteAddressBalanceIndex(const std::vector<std::pair<CAddressIndexKey, CAmount> > &vect, int height);
+    bool EraseAddressBalanceIndex(const std::vector<std::pair<CAddressIndexKey, CAmount> > &vect, int height);
+    /** Sum the whole address index into address balances, replacing them. */
+    bool BuildAddressBalanceIndex();
     bool WriteTimestampIndex(const CTimestampIndexKey &timestampIndex);
     bool ReadTimestampIndex(const unsigned int &high, const unsigned int &low, const bool fActiveOnly, std::vector<std::pair<uint256, unsigned int> > &vect);
     bool WriteTimestampBlockIndex(const CTimestampBlockIndexKey &blockhashIndex, const CTimestampBlockIndexValue &logicalts);
     bool ReadTimestampBlockIndex(const uint256 &hash, unsigned int &logicalTS);
+    bool WriteInviteStats(const uint256 &hash, const pog::InviteStats &stats);
+    bool ReadInviteStats(const uint256 &hash, pog::InviteStats &stats);
     bool WriteFlag(const std::string &name, bool fValue);
     bool ReadFlag(const std::string &name, bool &fValue);
+    /**
+     * Reads every block index entry into the index built by insertBlockIndex
+     * and passes each one to checkBlockIndex once its fields are set.
+     * Stops and returns false if checkBlockIndex does.
+     */
     bool LoadBlockIndexGuts(
-            const Consensus::Params& consensusParams,
-            std::function<CBlockIndex*(const uint256&)> insertBlockIndex);
+            std::function<CBlockIndex*(const uint256&)> insertBlockIndex,
+            std::function<bool(const CBlockIndex*)> checkBlockIndex);
 
     // Referrals
     bool ReadReferralIndex(const uint256 &txid, CDiskTxPos &pos);
     bool WriteReferralIndex(const std::vector<std::pair<uint256, CDiskTxPos> > &list);
+
+private:
+    /** Height of the latest address index entry of address below height, or -1 */
+    int ReadLastAddressIndexHeight(const CAddressIndexIteratorKey &address, int height);
 };
 
 #endif // MERIT_TXDB_H
@@ -403,9 +403,104 @@ bool CheckReferralSignature(const referral::Referral& ref)
     return ref.pubkey.Verify(hash, ref.signature);
 }
 
+static CuckooCache::cache<uint256, SignatureCacheHasher> referralSignatureCache;
+static uint256 referralSignatureCacheNonce(GetRandHash());
+static CCriticalSection cs_referral_signature_cache;
+
+void InitReferralSignatureCache() {
+    // Referrals are far fewer than signatures, so use an eighth of
+    // -maxsigcachesize for them.
+    size_t nMaxCacheSize = std::min(std::max((int64_t)0, gArgs.GetArg("-maxsigcachesize", DEFAULT_MAX_SIG_CACHE_SIZE) / 8), MAX_MAX_SIG_CACHE_SIZE) * ((size_t) 1 << 20);
+    size_t nElems = referralSignatureCache.setup_bytes(nMaxCacheSize);
+    LogPrintf("Using %zu MiB out of %zu/8 requested for referral signature cache, able to store %zu elements\n",
+            (nElems*sizeof(uint256)) >>20, (nMaxCacheSize*8)>>20, nElems);
+}
+
+/**
+ * The referral hash commits to the signature, the signed addresses and the
+ * pubkey, so a verified referral can be found by its hash alone.
+ */
+static uint256 ReferralSignatureCacheEntry(const referral::Referral& ref)
+{
+    uint256 entry;
+    CSHA256()
+        .Write(referralSignatureCacheNonce.begin(), 32)
+        .Write(ref.GetHash().begin(), 32)
+        .Finalize(entry.begin());
+    return entry;
+}
+
+static bool IsReferralSignatureCached(const uint256& entry, bool erase)
+{
+    LOCK(cs_referral_signature_cache);
+    return referralSignatureCache.contains(entry, erase);
+}
+
+bool CheckReferralSignature(const referral::Referral& ref, bool cacheStore)
+{
+    const auto entry = ReferralSignatureCacheEntry(ref);
+    if (IsReferralSignatureCached(entry, false)) {
+        return true;
+    }
+
+    if (!CheckReferralSignature(ref)) {
+        return false;
+    }
+
+    if (cacheStore) {
+        LOCK(cs_referral_signature_cache);
+        referralSignatureCache.insert(entry);
+    }
+
+    return true;
+}
+
+bool CReferralCheck::operator()() {
+    return CheckReferralSignature(*ref);
+}
+
+bool CProofOfWorkCheck::operator()() {
+    std::vector<cuckoo::ProofOfWork> proofs;
+    proofs.reserve(indexes.size());
+    for (const CBlockIndex* pindex : indexes) {
+        proofs.push_back({pindex->GetBlockHash(), pindex->nBits, pindex->nEdgeBits, &pindex->sCycle});
+    }
+
+    const auto valid = cuckoo::VerifyProofsOfWork(proofs, *params);
+    for (size_t i = 0; i < indexes.size(); i++) {
+        if (!valid[i]) {
+            return error("%s: CheckProofOfWork failed: %s", __func__, indexes[i]->ToString());
+        }
+    }
+    return true;
+}
+
+BlockAliases IndexBlockAliases(const CBlock& block, bool normalize_alias)
+{
+    BlockAliases aliases;
+    aliases.reserve(block.m_vRef.size());
+
+    for (const auto& ref : block.m_vRef) {
+        auto maybe_normalized = ref->alias;
+        if (normalize_alias) {
+            referral::NormalizeAlias(maybe_normalized);
+        }
+
+        if (maybe_normalized.empty()) {
+            continue;
+        }
+
+        auto inserted = aliases.emplace(std::move(maybe_normalized), BlockAlias{ref->GetHash(), false});
+        auto& alias = inserted.first->second;
+        alias.shared |= alias.hash != ref->GetHash();
+    }
+
+    return aliases;
+}
+
 bool CheckReferralAliasUnique(
     const referral::ReferralRef& referral_in,
-    const CBlock* block,
+    const BlockAliases* block_aliases,
     bool normalize_alias)
 {
     auto maybe_normalized = referral_in->alias;
@@ -413,22 +508,19 @@ bool CheckReferralAliasUnique(
         referral::NormalizeAlias(maybe_normalized);
     }
 
-    bool unique = !prefviewcache->IsConfirmed(maybe_normalized, false);
+    if (maybe_normalized.empty()) {
+        return true;
+    }
 
     // check block for same aliases if provided
-    if (unique && maybe_normalized.size() > 0 && block != nullptr) {
-        auto it = std::find_if (
-            block->m_vRef.begin(), block->m_vRef.end(),
-            [&referral_in, &maybe_normalized, normalize_alias](const referral::ReferralRef& ref) {
-                return
-                    referral::AliasesEqual(ref->alias, maybe_normalized, normalize_alias) &&
-                    ref->GetHash() != referral_in->GetHash();
-            });
-
-        unique &= it == block->m_vRef.end();
+    if (block_aliases != nullptr) {
+        auto it = block_aliases->find(maybe_normalized);
+        if (it != block_aliases->end() && it->second.shared) {
+            return false;
+        }
     }
 
-    return unique;
+    return !prefviewcache->IsConfirmed(maybe_normalized, false);
 }
 
 bool CheckFinalTx(const CTransaction &tx, int flags)
@@ -765,7 +857,7 @@ bool AcceptReferralToMemoryPoolWithTime(referral::ReferralTxMemPool& pool,
             return state.Invalid(false, REJECT_INVALID, "ref-parent-not-beaconed");
         }
 
-        if (!CheckReferralSignature(*referral)) {
+        if (!CheckReferralSignature(*referral, true)) {
             return state.Invalid(false, REJECT_INVALID, "ref-bad-sig");
         }
 
@@ -1577,6 +1669,18 @@ bool GetAddressUnspent(
     return true;
 }
 
+CAddressBalanceValue GetAddressBalance(
+        uint160 addressHash,
+        unsigned int type,
+        bool invite)
+{
+    CAddressBalanceValue value;
+    if (!pblocktree->ReadAddressBalance(addressHash, type, invite, value))
+        value.SetNull();
+
+    return value;
+}
+
 /** Return transaction in txOut, and if it was found inside a block, its hash is placed in hashBlock */
 bool GetTransaction(
         const uint256 &hash,
@@ -1750,10 +1854,14 @@ bool ReadBlockFromDisk(
         const Consensus::Params& consensusParams,
         bool validate)
 {
+    // the proof of work of the entry was checked when its header was accepted,
+    // and LoadBlockIndexDB checks it for every entry read at startup
+    const bool checkProofOfWork = validate && !pindex->IsValid(BLOCK_VALID_TREE);
+
     if (!ReadBlockFromDisk(
                 block, pindex->GetBlockPos(),
                 consensusParams,
-                validate)) {
+                checkProofOfWork)) {
         return false;
     }
 
@@ -1762,6 +1870,51 @@ bool ReadBlockFromDisk(
                 pindex->ToString(), pindex->GetBlockPos().ToString());
     }
 
+    // the block hash does not cover the cycle
+    if (block.sCycle != pindex->sCycle) {
+        return error("ReadBlockFromDisk(CBlock&, CBlockIndex*): cycle doesn't match index for %s at %s",
+                pindex->ToString(), pindex->GetBlockPos().ToString());
+    }
+
+    return true;
+}
+
+bool ReadRawBlockFromDisk(
+        std::vector<uint8_t>& block,
+        const CBlockIndex* pindex,
+        const CMessageHeader::MessageStartChars& messageStart)
+{
+    // the message start and size written by WriteBlockToDisk precede the block
+    const CDiskBlockPos pos = pindex->GetBlockPos();
+    CDiskBlockPos hpos = pos;
+    hpos.nPos -= CMessageHeader::MESSAGE_START_SIZE + sizeof(unsigned int);
+
+    CAutoFile filein(OpenBlockFile(hpos, true), SER_DISK, CLIENT_VERSION);
+    if (filein.IsNull())
+        return error("ReadRawBlockFromDisk: OpenBlockFile failed for %s", pos.ToString());
+
+    try {
+        CMessageHeader::MessageStartChars blkStart;
+        unsigned int nSize;
+        filein >> FLATDATA(blkStart) >> nSize;
+
+        if (memcmp(blkStart, messageStart, CMessageHeader::MESSAGE_START_SIZE)) {
+            return error("%s: Block magic mismatch for %s: %s versus expected %s", __func__, pos.ToString(),
+                    HexStr(blkStart, blkStart + CMessageHeader::MESSAGE_START_SIZE),
+                    HexStr(messageStart, messageStart + CMessageHeader::MESSAGE_START_SIZE));
+        }
+
+        if (nSize > MAX_SIZE) {
+            return error("%s: Block size %u is larger than the maximum deserialization size at %s", __func__, nSize, pos.ToString());
+        }
+
+        block.resize(nSize);
+        filein.read(reinterpret_cast<char*>(block.data()), nSize);
+    }
+    catch (const std::exception& e) {
+        return error("%s: Deserialize or I/O error - %s at %s", __func__, e.what(), pos.ToString());
+    }
+
     return true;
 }
 
@@ -1826,22 +1979,35 @@ pog::AmbassadorLottery RewardAmbassadors(
         height >= params.vDeployments[Consensus::DEPLOYMENT_DAEDALUS].start_block;
 
     static size_t max_embassador_lottery = 0;
-    referral::AddressANVs entrants;
+    std::unique_ptr<pog::WalletSelector> selector;
+
+    // From block 16000 entrants are sorted by ANV and address, which is the
+    // order the referral db keeps them in, so sample from it directly. Older
+    // blocks need the legacy sort over the entrants in reservoir order.
+    const auto* tree = height >= 16000 ?
+        prefviewdb->GetRewardableANVTree(params.genesis_address) :
+        nullptr;
 
-    // unlikely that the candidates grew over 50% since last time.
-    auto reserve_size = max_embassador_lottery * 1.5;
-    entrants.reserve(reserve_size);
+    if (tree) {
+        selector.reset(new pog::WalletSelector{*tree});
+    } else {
+        referral::AddressANVs entrants;
 
-    pog::GetAllRewardableANVs(*prefviewdb, params, height, entrants);
+        // unlikely that the candidates grew over 50% since last time.
+        auto reserve_size = max_embassador_lottery * 1.5;
+        entrants.reserve(reserve_size);
 
-    max_embassador_lottery = std::max(max_embassador_lottery, entrants.size());
+        pog::GetAllRewardableANVs(*prefviewdb, params, height, entrants);
 
-    // Wallet selector will create a distribution from all the keys
-    pog::WalletSelector selector{height, entrants};
+        max_embassador_lottery = std::max(max_embassador_lottery, entrants.size());
+
+        // Wallet selector will create a distribution from all the keys
+        selector.reset(new pog::WalletSelector{height, entrants});
+    }
 
     // We may have fewer keys in the distribution than the expected winners,
     // so just pick smallest of the two.
-    const auto desired_winners = std::min(params.total_winning_ambassadors, static_cast<uint64_t>(selector.Size()));
+    const auto desired_winners = std::min(params.total_winning_ambassadors, static_cast<uint64_t>(selector->Size()));
 
     // If we have an empty distribution, for example in some of the unit
     // tests, we return the whole ambassador amount back to the miner
@@ -1852,7 +2018,7 @@ pog::AmbassadorLottery RewardAmbassadors(
     assert(desired_winners < 100);
 
     // Select the N winners using the previous block hash as the seed
-    auto winners = selector.Select(
+    auto winners = selector->Select(
             is_daedalus,
             *prefviewcache,
             previous_block_hash,
@@ -2813,16 +2979,7 @@ bool GetDebitsAndCredits(DebitsAndCredits& debits_and_credits, const CTransactio
 bool UpdateANV(const DebitsAndCredits& debits_and_credits)
 {
     //apply the debit and credits to the addresses in the block transactions.
-    for (const auto& t : debits_and_credits) {
-        const auto addressType = std::get<0>(t);
-        const auto& address = std::get<1>(t);
-        const auto amount = std::get<2>(t);
-        if (!prefviewdb->UpdateANV(addressType, address, amount)) {
-            return false;
-        }
-    }
-
-    return true;
+    return prefviewdb->UpdateANVs(debits_and_credits);
 }
 
 bool UpdateANV(const CBlock& block, CCoinsViewCache& view) {
@@ -2841,11 +2998,11 @@ bool IndexReferrals(
         bool allow_no_parent,
         bool normalize_alias)
 {
-    assert(prefviewdb);
+    assert(prefviewcache);
 
     // Update offset and Record referrals into the referral DB
     for (const auto& rtx : ordered_referrals) {
-        if (!prefviewdb->InsertReferral(*rtx, allow_no_parent, normalize_alias)) {
+        if (!prefviewcache->InsertReferral(*rtx, allow_no_parent, normalize_alias)) {
             return false;
         }
     }
@@ -3206,6 +3363,7 @@ static DisconnectResult DisconnectBlock(
     }
 
     fClean &= pblocktree->EraseAddressIndex(addressIndex);
+    fClean &= pblocktree->EraseAddressBalanceIndex(addressIndex, pindex->nHeight);
     fClean &= pblocktree->UpdateAddressUnspentIndex(addressUnspentIndex);
     fClean &= pblocktree->UpdateSpentIndex(spentIndex);
 
@@ -3276,6 +3434,21 @@ void ThreadScriptCheck() {
     scriptcheckqueue.Thread();
 }
 
+static CCheckQueue<CReferralCheck> referralcheckqueue(128);
+
+void ThreadReferralCheck() {
+    RenameThread("merit-refch");
+    referralcheckqueue.Thread();
+}
+
+// Every check is already a batch of block index entries.
+static CCheckQueue<CProofOfWorkCheck> powcheckqueue(1);
+
+void ThreadProofOfWorkCheck() {
+    RenameThread("merit-powch");
+    powcheckqueue.Thread();
+}
+
 // Protected by cs_main
 VersionBitsCache versionbitscache;
 
@@ -3838,6 +4011,7 @@ static bool ConnectBlock(
     CBlockUndo blockundo;
 
     CCheckQueueControl<CScriptCheck> control(fScriptChecks && nScriptCheckThreads ? &scriptcheckqueue : nullptr);
+    CCheckQueueControl<CReferralCheck> referral_control(nScriptCheckThreads ? &referralcheckqueue : nullptr);
 
     std::vector<int> prevheights;
     CAmount nFees = 0;
@@ -4036,6 +4210,12 @@ static bool ConnectBlock(
 
     int64_t nTime7 = GetTimeMicros();
     if (validate) {
+        std::vector<CReferralCheck> referral_checks;
+        referral_checks.reserve(block.m_vRef.size());
+
+        const bool normalize_alias = pindex->nHeight >= chainparams.GetConsensus().safer_alias_blockheight;
+        const auto block_aliases = IndexBlockAliases(block, normalize_alias);
+
         for (const auto& ref: block.m_vRef) {
             if (CheckAddressBeaconed(ref->GetAddress(), false)) {
                 return state.DoS(100,
@@ -4043,22 +4223,29 @@ static bool ConnectBlock(
                         REJECT_INVALID, "bad-ref-address-beaconed");
             }
 
-            if (!CheckReferralSignature(*ref)) {
-                return state.DoS(100,
-                        error("ConnectBlock(): referral sig check failed on %s", ref->GetHash().GetHex()),
-                        REJECT_INVALID, "bad-ref-sig-failed");
+            // Referrals accepted to the mempool already had their signature
+            // verified. Don't keep them cached once the block is connected.
+            if (!IsReferralSignatureCached(ReferralSignatureCacheEntry(*ref), !fJustCheck)) {
+                CReferralCheck check{*ref};
+
+                if (nScriptCheckThreads) {
+                    referral_checks.push_back(check);
+                } else if (!check()) {
+                    return state.DoS(100,
+                            error("ConnectBlock(): referral sig check failed on %s", ref->GetHash().GetHex()),
+                            REJECT_INVALID, "bad-ref-sig-failed");
+                }
             }
 
             // is referral alias already occupied?
-            if (!CheckReferralAliasUnique(
-                        ref,
-                        &block,
-                        pindex->nHeight >= chainparams.GetConsensus().safer_alias_blockheight)) {
+            if (!CheckReferralAliasUnique(ref, &block_aliases, normalize_alias)) {
 
                 return error("ConnectBlock(): Referral %s alias \"%s\" is already occupied", ref->GetHash().GetHex(), ref->alias);
             }
         }
 
+        referral_control.Add(referral_checks);
+
         if (block.IsDaedalus() && !ValidateReferralsAreConfirmed(block)) {
             return state.DoS(
                     100,
@@ -4206,6 +4393,10 @@ static bool ConnectBlock(
     }
 
 
+    if (!referral_control.Wait()) {
+        return state.DoS(100, error("ConnectBlock(): referral sig check failed"), REJECT_INVALID, "bad-ref-sig-failed");
+    }
+
     if (!control.Wait()) {
         return state.DoS(100, error("%s: CheckQueue failed", __func__), REJECT_INVALID, "block-validation-failed");
     }
@@ -4276,6 +4467,10 @@ static bool ConnectBlock(
         return AbortNode(state, "Failed to write address index");
     }
 
+    if (!pblocktree->WriteAddressBalanceIndex(addressIndex, pindex->nHeight)) {
+        return AbortNode(state, "Failed to write address balance index");
+    }
+
     if (!pblocktree->UpdateAddressUnspentIndex(addressUnspentIndex)) {
         return AbortNode(state, "Failed to write address unspent index");
     }
@@ -4305,6 +4500,12 @@ static bool ConnectBlock(
         return AbortNode(state, "Failed to write blockhash index");
     }
 
+    pog::InviteStats invite_stats;
+    pog::ComputeStats(pindex->nHeight, block, blockundo.invites_undo, invite_stats, chainparams.GetConsensus());
+    if (!pblocktree->WriteInviteStats(pindex->GetBlockHash(), invite_stats)) {
+        return AbortNode(state, "Failed to write invite stats");
+    }
+
     if (!UpdateAndIndexReferralOffset(block, curBlockPos, pos.nTxOffset)) {
         return AbortNode(state, "Failed to write referral transaction index");
     }
@@ -4381,6 +4582,9 @@ bool static FlushStateToDisk(const CChainParams& chainparams, CValidationState &
         int64_t nMempoolSizeMax = gArgs.GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000;
         int64_t nReferralsMempoolSizeMax = gArgs.GetArg("-maxrefmempool", DEFAULT_MAX_REFERRALS_MEMPOOL_SIZE) * 1000000;
         int64_t cacheSize = pcoinsTip->DynamicMemoryUsage();
+        if (prefviewdb) {
+            cacheSize += prefviewdb->DynamicMemoryUsage();
+        }
         int64_t nTotalSpace = nCoinCacheUsage + std::max<int64_t>(nMempoolSizeMax - nMempoolUsage, 0) + std::max<int64_t>(nReferralsMempoolSizeMax - nReferralsMempoolUsage, 0);
 
         // The cache is large and we're within 10% and 10 MiB of the limit, but we have time now (not in the middle of a block processing).
@@ -4417,6 +4621,9 @@ bool static FlushStateToDisk(const CChainParams& chainparams, CValidationState &
                 if (!pblocktree->WriteBatchSync(vFiles, nLastBlockFile, vBlocks)) {
                     return AbortNode(state, "Failed to write to block index database");
                 }
+                if (!inviteBuffer.flush()) {
+                    return AbortNode(state, "Failed to write invite stats");
+                }
             }
             // Finally remove any pruned files
             if (fFlushForPrune)
@@ -4432,6 +4639,13 @@ bool static FlushStateToDisk(const CChainParams& chainparams, CValidationState &
             // overwrite one. Still, use a conservative safety factor of 2.
             if (!CheckDiskSpace(48 * 2 * 2 * pcoinsTip->GetCacheSize()))
                 return state.Error("out of disk space");
+            // Flush the referral changes made by the connected blocks in one
+            // batch, tagged with the tip the chainstate is about to record.
+            // The two flushes are separate writes. A crash between them
+            // leaves the markers disagreeing, which init reports and which
+            // only -reindex-chainstate fixes.
+            if (prefviewdb && !prefviewdb->Flush(pcoinsTip->GetBestBlock()))
+                return AbortNode(state, "Failed to write to referral database");
             // Flush the chainstate (which may refer to block index entries).
             if (!pcoinsTip->Flush())
                 return AbortNode(state, "Failed to write to coin database");
@@ -5832,9 +6046,32 @@ bool ProcessNewBlockHeaders(const std::vector<CBlockHeader>& headers, CValidatio
 {
     {
         LOCK(cs_main);
-        for (const CBlockHeader& header : headers) {
+
+        // Check the proofs of work of all new headers in one batch. A header
+        // whose proof failed is checked again on its own below, so it is
+        // rejected the same way as before.
+        std::vector<cuckoo::ProofOfWork> proofs;
+        std::vector<size_t> proof_of_header(headers.size(), headers.size());
+        for (size_t i = 0; i < headers.size(); i++) {
+            const auto& header = headers[i];
+            const auto hash = header.GetHash();
+            if (mapBlockIndex.count(hash)) {
+                continue;
+            }
+
+            proof_of_header[i] = proofs.size();
+            proofs.push_back({hash, header.nBits, header.nEdgeBits, &header.sCycle});
+        }
+
+        const auto valid_pow = cuckoo::VerifyProofsOfWork(proofs, chainparams.GetConsensus());
+
+        for (size_t i = 0; i < headers.size(); i++) {
+            const auto& header = headers[i];
+            const bool check_pow =
+                proof_of_header[i] == headers.size() || !valid_pow[proof_of_header[i]];
+
             CBlockIndex *pindex = nullptr; // Use a temp pindex instead of ppindex to avoid a const_cast
-            if (!AcceptBlockHeader(header, state, chainparams, &pindex)) {
+            if (!AcceptBlockHeader(header, state, chainparams, &pindex, check_pow)) {
                 return false;
             }
             if (ppindex) {
@@ -6206,11 +6443,58 @@ CBlockIndex * InsertBlockIndex(uint256 hash)
     return pindexNew;
 }
 
+/** Number of block index entries whose proofs of work are checked together at startup */
+static const size_t BLOCK_INDEX_POW_BATCH_SIZE = 256;
+
 bool static LoadBlockIndexDB(const CChainParams& chainparams)
 {
-    if (!pblocktree->LoadBlockIndexGuts(chainparams.GetConsensus(), InsertBlockIndex))
+    const int64_t nLoadStart = GetTimeMicros();
+
+    // The proofs of work of the entries are checked in batches on the proof
+    // of work check threads while the rest of the index is read. Every entry
+    // is checked: the block hash does not commit to the cycle, so the hashPrev
+    // chain of a trusted block would not vouch for the cycles of its
+    // ancestors, and reads of validated blocks rely on the cycle in the index.
+    CCheckQueueControl<CProofOfWorkCheck> control(nScriptCheckThreads ? &powcheckqueue : nullptr);
+    std::vector<const CBlockIndex*> vBatch;
+    size_t nChecked = 0;
+    bool fPoWValid = true;
+
+    const auto checkBatch = [&]() {
+        nChecked += vBatch.size();
+        std::vector<CProofOfWorkCheck> vChecks(1);
+        CProofOfWorkCheck(std::move(vBatch), chainparams.GetConsensus()).swap(vChecks[0]);
+        vBatch.clear();
+
+        if (nScriptCheckThreads) {
+            control.Add(vChecks);
+        } else {
+            fPoWValid = vChecks[0]();
+        }
+    };
+
+    const auto checkBlockIndex = [&](const CBlockIndex* pindex) {
+        vBatch.push_back(pindex);
+        if (vBatch.size() == BLOCK_INDEX_POW_BATCH_SIZE) {
+            checkBatch();
+        }
+        return fPoWValid;
+    };
+
+    if (!pblocktree->LoadBlockIndexGuts(InsertBlockIndex, checkBlockIndex))
         return false;
 
+    if (!vBatch.empty()) {
+        checkBatch();
+    }
+
+    if (!control.Wait() || !fPoWValid) {
+        return false;
+    }
+
+    LogPrintf("%s: loaded %u block index entries in %.2fs, checked %u proofs of work\n",
+            __func__, mapBlockIndex.size(), (GetTimeMicros() - nLoadStart) * MICRO, nChecked);
+
     boost::this_thread::interruption_point();
 
     // Calculate nChainWork
@@ -6291,6 +6575,16 @@ bool static LoadBlockIndexDB(const CChainParams& chainparams)
     if (fHavePruned)
         LogPrintf("LoadBlockIndexDB(): Block files have previously been pruned\n");
 
+    // Address balances were added after the address index, so older
+    // databases sum it once
+    bool fAddressBalances = false;
+    pblocktree->ReadFlag("addressbalanceindex", fAddressBalances);
+    if (!fAddressBalances) {
+        LogPrintf("LoadBlockIndexDB(): Building address balance index\n");
+        if (!pblocktree->BuildAddressBalanceIndex() || !pblocktree->WriteFlag("addressbalanceindex", true))
+            return error("LoadBlockIndexDB(): failed to build address balance index");
+    }
+
     // Check whether we need to continue reindexing
     bool fReindexing = false;
     pblocktree->ReadReindexing(fReindexing);
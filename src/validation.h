@@ -252,6 +252,16 @@ using AddressPair = std::pair<uint160, char>;
 
 using DebitsAndCredits = std::vector<std::tuple<char, referral::Address, CAmount>>;
 
+/** A referral alias used in a block. shared is set when referrals with
+ * different hashes use it. */
+struct BlockAlias
+{
+    uint256 hash;
+    bool shared;
+};
+
+using BlockAliases = std::unordered_map<std::string, BlockAlias>;
+
 /**
  * Process an incoming block. This only returns after the best known valid
  * block is made active. Note that it does not, however, guarantee that the
@@ -313,6 +323,10 @@ bool LoadChainTip(const CChainParams& chainparams, bool sample);
 void UnloadBlockIndex();
 /** Run an instance of the script checking thread */
 void ThreadScriptCheck();
+/** Run an instance of the referral checking thread */
+void ThreadReferralCheck();
+/** Run an instance of the proof of work checking thread */
+void ThreadProofOfWorkCheck();
 /** Check whether we are doing an initial block download (synchronizing from disk or network) */
 bool IsInitialBlockDownload();
 /** Retrieve a transaction (from memory pool, or from disk, if possible) */
@@ -325,8 +339,17 @@ bool ActivateBestChain(
         const CChainParams& chainparams,
         std::shared_ptr<const CBlock> pblock = std::shared_ptr<const CBlock>(),
         bool sample = false);
+/** Index the aliases of a block's referrals, normalized if normalize_alias is set */
+BlockAliases IndexBlockAliases(const CBlock& block, bool normalize_alias);
+/** Check that no other referral in the block nor a confirmed one uses the referral's alias */
+bool CheckReferralAliasUnique(
+        const referral::ReferralRef& referral,
+        const BlockAliases* block_aliases,
+        bool normalize_alias);
 /** Check whether referral signature is valid */
 bool CheckReferralSignature(const referral::Referral& ref);
+/** Check whether referral signature is valid, consulting the referral signature cache first */
+bool CheckReferralSignature(const referral::Referral& ref, bool cacheStore);
 /** Build a set of confirmed address in block */
 void BuildConfirmationSet(const CTransactionRef& invite, ConfirmationSet& confirmations_in_block);
 /** Extract address and address type from tx out */
@@ -527,6 +550,52 @@ public:
     ScriptError GetScriptError() const { return error; }
 };
 
+/**
+ * Closure representing one referral signature verification
+ * Note that this stores a reference to the referral
+ */
+class CReferralCheck
+{
+private:
+    const referral::Referral *ref;
+
+public:
+    CReferralCheck(): ref{nullptr} {}
+
+    explicit CReferralCheck(const referral::Referral& refIn): ref{&refIn} {}
+
+    bool operator()();
+
+    void swap(CReferralCheck &check) {
+        std::swap(ref, check.ref);
+    }
+};
+
+/**
+ * Closure representing the proof of work checks of a batch of block index
+ * entries, as they are loaded at startup.
+ * Note that this stores references to the entries
+ */
+class CProofOfWorkCheck
+{
+private:
+    std::vector<const CBlockIndex*> indexes;
+    const Consensus::Params *params;
+
+public:
+    CProofOfWorkCheck(): params{nullptr} {}
+
+    CProofOfWorkCheck(std::vector<const CBlockIndex*> indexesIn, const Consensus::Params& paramsIn):
+        indexes{std::move(indexesIn)}, params{&paramsIn} {}
+
+    bool operator()();
+
+    void swap(CProofOfWorkCheck &check) {
+        indexes.swap(check.indexes);
+        std::swap(params, check.params);
+    }
+};
+
 bool GetTimestampIndex(const unsigned int &high, const unsigned int &low, const bool fActiveOnly, std::vector<std::pair<uint256, unsigned int> > &hashes);
 bool GetSpentIndex(const CSpentIndexKey &key, CSpentIndexValue &value);
 bool HashOnchainActive(const uint256 &hash);
@@ -544,9 +613,18 @@ bool GetAddressUnspent(
         bool invite,
         std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs);
 
+/** Running totals of the address index entries of an address, null if it has none */
+CAddressBalanceValue GetAddressBalance(
+        uint160 addressHash,
+        unsigned int type,
+        bool invite);
+
 /** Initializes the script-execution cache */
 void InitScriptExecutionCache();
 
+/** Initializes the cache of verified referral signatures */
+void InitReferralSignatureCache();
+
 
 /** Functions for disk access for blocks */
 bool ReadBlockFromDisk(
@@ -555,12 +633,29 @@ bool ReadBlockFromDisk(
         const Consensus::Params& consensusParams,
         bool validate = true);
 
+/**
+ * Read the block of an index entry. The proof of work of an entry which is
+ * at least BLOCK_VALID_TREE was checked when its header was accepted or when
+ * the block index was loaded, so it is only checked again for entries below
+ * that. The block read must match the hash and the cycle of the entry either
+ * way, since the hash does not cover the cycle.
+ */
 bool ReadBlockFromDisk(
         CBlock& block,
         const CBlockIndex* pindex,
         const Consensus::Params& consensusParams,
         bool validate = true);
 
+/**
+ * Read the serialized block of an index entry without deserializing it. The
+ * bytes are the block as stored on disk, which is the network serialization
+ * with witnesses, so they can be relayed to peers as they are.
+ */
+bool ReadRawBlockFromDisk(
+        std::vector<uint8_t>& block,
+        const CBlockIndex* pindex,
+        const CMessageHeader::MessageStartChars& messageStart);
+
 /** Functions for validating blocks and updating the block tree */
 
 /** Context-independent validity checks */
@@ -6,6 +6,8 @@
 #include "validation.h"
 #include "sync.h"
 #include <algorithm>
+#include <map>
+#include <set>
 #include "core_io.h"
 
 
@@ -21,69 +23,8 @@ bool Vault::SameKind(const Vault& o) const
 
 using MempoolOutput = std::pair<CMempoolAddressDeltaKey, CMempoolAddressDelta>;
 using MempoolOutputs = std::vector<MempoolOutput>;
-
-void FilterMempoolOutputs(const MempoolOutputs& outputs, MempoolOutputs& filtered)
-{
-    std::set<uint256> spending;
-
-    for(const auto& out : outputs) {
-        if(!out.first.spending) continue;
-
-        spending.insert(out.second.prevhash);
-    }
-
-    filtered.reserve(outputs.size());
-
-    std::copy_if(outputs.begin(), outputs.end(), std::back_inserter(filtered),
-            [&spending](const MempoolOutput& out) {
-                return !spending.count(out.first.txhash);
-            });
-}
-
-template <class Transactions>
-void ConvertToVaultOutputs(const Transactions& txns, VaultOutputs& outputs)
-{
-    using Transaction = typename Transactions::value_type;
-    Transactions utxos;
-    utxos.reserve(txns.size());
-
-    std::copy_if(txns.begin(), txns.end(), std::back_inserter(utxos),
-            [](const Transaction& t) {
-                return !t.first.spending;
-            });
-
-    outputs.resize(outputs.size() + utxos.size());
-
-    std::transform(utxos.begin(), utxos.end(), outputs.begin(),
-        [](const Transaction& p) {
-            return COutPoint{
-                p.first.txhash,
-                static_cast<uint32_t>(p.first.index)};
-        });
-}
-
-VaultOutputs GetUnspentOutputs(CCoinsViewCache& view, const VaultOutputs& outputs)
-{
-    VaultOutputs unspent;
-    unspent.reserve(outputs.size());
-    std::copy_if(std::begin(outputs), std::end(outputs), std::back_inserter(unspent),
-            [&view](const COutPoint& p) {
-                return view.HaveCoin(p);
-            });
-
-    return unspent;
-}
-
-VaultCoins GetUnspentCoins(CCoinsViewCache& view, const VaultOutputs& unspent)
-{
-    VaultCoins coins(unspent.size());
-    std::transform(std::begin(unspent), std::end(unspent), std::begin(coins),
-            [&view](const COutPoint& p) {
-                const auto& c = view.AccessCoin(p);
-                return std::make_pair(p, c);
-            });
-    return coins;
-}
+using ChainOutput = std::pair<CAddressUnspentKey, CAddressUnspentValue>;
+using ChainOutputs = std::vector<ChainOutput>;
 
 VaultCoins FilterVaultCoins(const VaultCoins& coins, const uint160& address)
 {
@@ -106,33 +47,60 @@ VaultCoins FilterVaultCoins(const VaultCoins& coins, const uint160& address)
 
 VaultCoins FindUnspentVaultCoins(const uint160& address)
 {
-    VaultOutputs outputs;
+    AssertLockHeld(cs_main);
 
-    //Get outputs from mempool
     const int PARAM_SCRIPT_TYPE = 3;
+
+    //Get unspent outputs from chain
+    ChainOutputs chain_outputs;
+    if(!GetAddressUnspent(address, PARAM_SCRIPT_TYPE, false, chain_outputs)) {
+        return {};
+    }
+
+    //Get outputs the mempool creates and spends
     std::vector<AddressPair> addresses = {{address, PARAM_SCRIPT_TYPE}};
     MempoolOutputs mempool_outputs;
     mempool.getAddressIndex(addresses, mempool_outputs);
 
-    MempoolOutputs filtered_mempool_outputs;
-    FilterMempoolOutputs(mempool_outputs, filtered_mempool_outputs);
-    ConvertToVaultOutputs(filtered_mempool_outputs, outputs);
+    std::set<COutPoint> mempool_spent;
+    for(const auto& out : mempool_outputs) {
+        if(out.first.spending) {
+            mempool_spent.emplace(out.second.prevhash, out.second.prevout);
+        }
+    }
 
-    //Get outputs from chain
-    using ChainOutputs = std::vector<std::pair<CAddressIndexKey, CAmount>>;
-    ChainOutputs chain_outputs;
-    GetAddressIndex(address, PARAM_SCRIPT_TYPE, false, chain_outputs);
-    ConvertToVaultOutputs(chain_outputs, outputs);
-
-    //Filter outputs and return only unspent coins
-    LOCK(mempool.cs);
-    CCoinsViewCache &view_chain = *pcoinsTip;
-    CCoinsViewMemPool viewMempool(&view_chain, mempool);
-    CCoinsViewCache view(&viewMempool);
-
-    auto unspent_outputs = GetUnspentOutputs(view, outputs);
-    auto unspent_coins = GetUnspentCoins(view, unspent_outputs);
-    return FilterVaultCoins(unspent_coins, address);
+    VaultCoins coins;
+    coins.reserve(chain_outputs.size() + mempool_outputs.size());
+
+    for(const auto& out : chain_outputs) {
+        COutPoint out_point{out.first.txhash, out.first.index};
+        if(mempool_spent.count(out_point)) continue;
+
+        coins.emplace_back(
+                out_point,
+                Coin{
+                    CTxOut{out.second.satoshis, out.second.script},
+                    out.second.blockHeight,
+                    out.first.isCoinbase,
+                    out.first.isInvite});
+    }
+
+    for(const auto& out : mempool_outputs) {
+        if(out.first.spending || out.first.invite) continue;
+
+        COutPoint out_point{out.first.txhash, out.first.index};
+        if(mempool_spent.count(out_point)) continue;
+
+        coins.emplace_back(
+                out_point,
+                Coin{
+                    CTxOut{out.second.amount, out.second.scriptPubKey},
+                    MEMPOOL_HEIGHT,
+                    false,
+                    false});
+    }
+
+    return FilterVaultCoins(coins, address);
 }
 
 
@@ -248,8 +216,25 @@ Vault ParseVaultCoin(const VaultCoin& coin)
 
 Vaults ParseVaultCoins(const VaultCoins& coins)
 {
-    Vaults vaults(coins.size());
-    std::transform(coins.begin(), coins.end(), vaults.begin(), ParseVaultCoin);
+    //Coins at a vault address share one scriptPubKey, so its parameters
+    //are only parsed once and the rest of the coins reuse them.
+    std::map<CScript, Vault> parsed;
+
+    Vaults vaults;
+    vaults.reserve(coins.size());
+    for(const auto& coin : coins) {
+        const auto& script = coin.second.out.scriptPubKey;
+        auto it = parsed.find(script);
+        if(it == parsed.end()) {
+            it = parsed.emplace(script, ParseVaultCoin(coin)).first;
+        }
+
+        Vault vault = it->second;
+        vault.txid = coin.first.hash;
+        vault.coin = coin.second;
+        vault.out_point = coin.first;
+        vaults.push_back(std::move(vault));
+    }
     return vaults;
 }
 
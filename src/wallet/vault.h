@@ -19,15 +19,14 @@ namespace vault
 
 using VaultCoin = std::pair<COutPoint, Coin>;
 using VaultCoins = std::vector<VaultCoin>;
-using VaultOutputs = std::vector<COutPoint>;
 using WhitelistAddress = std::vector<unsigned char>;
 using Whitelist = std::vector<WhitelistAddress>;
 using PubKeys = std::vector<CPubKey>;
 
-VaultOutputs GetUnspentOutputs(CCoinsViewCache& view, const VaultOutputs& outputs);
-VaultCoins GetUnspentCoins(CCoinsViewCache& view, const VaultOutputs& unspent);
-
 VaultCoins FilterVaultCoins(const VaultCoins& coins, const uint160& address);
+
+/** Unspent coins of the vault address, read from the address unspent index
+ * with the mempool's spent and created outputs applied on top. */
 VaultCoins FindUnspentVaultCoins(const uint160& address);
 
 struct Vault
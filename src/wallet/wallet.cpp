@@ -37,10 +37,13 @@
 #include "wallet/fees.h"
 
 #include <assert.h>
+#include <future>
+#include <iterator>
 #include <numeric>
 #include <sstream>
 
 #include <boost/algorithm/string/replace.hpp>
+#include <boost/optional.hpp>
 #include <boost/thread.hpp>
 
 std::vector<CWalletRef> vpwallets;
@@ -49,6 +52,7 @@ CFeeRate payTxFee(DEFAULT_TRANSACTION_FEE);
 unsigned int nTxConfirmTarget = DEFAULT_TX_CONFIRM_TARGET;
 bool bSpendZeroConfChange = DEFAULT_SPEND_ZEROCONF_CHANGE;
 bool fWalletRbf = DEFAULT_WALLET_RBF;
+bool fWalletCheckBalances = DEFAULT_WALLET_CHECK_BALANCES;
 
 const char * DEFAULT_WALLET_DAT = "wallet.dat";
 const uint32_t BIP32_HARDENED_KEY_LIMIT = 0x80000000;
@@ -1117,6 +1121,7 @@ void CWallet::MarkDirty()
         LOCK(cs_wallet);
         for (std::pair<const uint256, CWalletTx>& item : mapWallet)
             item.second.MarkDirty();
+        MarkBalancesDirty();
     }
 }
 
@@ -1208,6 +1213,7 @@ bool CWallet::AddToWallet(const CWalletTx& wtxIn, bool fFlushOnClose)
 
     // Break debit/credit balance caches:
     wtx.MarkDirty();
+    MarkBalancesDirty();
 
     // Notify UI of new or updated transaction
     NotifyTransactionChanged(this, hash, fInsertedNew ? CT_NEW : CT_UPDATED);
@@ -1308,6 +1314,7 @@ bool CWallet::LoadToWallet(const CWalletTx& wtxIn)
     wtx.BindWallet(this);
     wtxOrdered.insert(std::make_pair(wtx.nOrderPos, TxPair(&wtx, nullptr)));
     AddToSpends(hash);
+    MarkBalancesDirty();
     for (const CTxIn& txin : wtx.tx->vin) {
         auto it = mapWallet.find(txin.prevout.hash);
         if (it != mapWallet.end()) {
@@ -1504,6 +1511,7 @@ bool CWallet::AbandonTransaction(const uint256& hashTx)
             wtx.nIndex = -1;
             wtx.setAbandoned();
             wtx.MarkDirty();
+            MarkBalancesDirty();
             walletdb.WriteTx(wtx);
             NotifyTransactionChanged(this, wtx.GetHash(), CT_UPDATED);
             // Iterate over all its outputs, and mark transactions in the wallet that spend them abandoned too
@@ -1569,6 +1577,7 @@ void CWallet::MarkConflicted(const uint256& hashBlock, const uint256& hashTx)
             wtx.nIndex = -1;
             wtx.hashBlock = hashBlock;
             wtx.MarkDirty();
+            MarkBalancesDirty();
             walletdb.WriteTx(wtx);
             // Iterate over all its outputs, and mark transactions in the wallet that spend them conflicted too
             TxSpends::const_iterator iter = mapTxSpends.lower_bound(COutPoint(now, 0));
@@ -1605,6 +1614,7 @@ void CWallet::SyncTransaction(const CTransactionRef& ptx, const CBlockIndex *pin
             it->second.MarkDirty();
         }
     }
+    MarkBalancesDirty();
 }
 
 void CWallet::TransactionAddedToMempool(const CTransactionRef& ptx) {
@@ -1646,6 +1656,9 @@ void CWallet::BlockConnected(const std::shared_ptr<const CBlock>& pblock, const
     for (size_t i = 0; i < pblock->m_vRef.size(); i++) {
         SyncTransaction(pblock->m_vRef[i], pindex, i);
     }
+
+    // Coinbase maturity and confirmation depths moved with the tip.
+    MarkBalancesDirty();
 }
 
 void CWallet::BlockDisconnected(const std::shared_ptr<const CBlock>& pblock) {
@@ -1662,6 +1675,8 @@ void CWallet::BlockDisconnected(const std::shared_ptr<const CBlock>& pblock) {
     for (const auto& pref : pblock->m_vRef) {
         SyncTransaction(pref);
     }
+
+    MarkBalancesDirty();
 }
 
 isminetype CWallet::IsMine(const CTxIn &txin) const
@@ -2117,6 +2132,10 @@ bool CWallet::SetUnlockReferralTx(const referral::ReferralTx& rtx, bool topUpKey
 
     // set referral tx as unlock tx
     m_unlockReferralTx = rtx;
+    {
+        LOCK(cs_wallet);
+        MarkBalancesDirty();
+    }
 
     if (topUpKeyPool) {
         // top up keypool after unlocking wallet
@@ -2280,32 +2299,289 @@ int64_t CWallet::RescanFromTime(int64_t startTime, bool update)
     return startTime;
 }
 
+namespace {
+    //! Number of blocks a rescan reads ahead of the one it scans.
+    const size_t RESCAN_BATCH_SIZE = 100;
+
+    using RescanBlocks = std::vector<std::pair<CBlockIndex*, std::shared_ptr<CBlock>>>;
+
+    /**
+     * Where a block of a rescan batch is stored, taken under cs_main so the
+     * reading thread never looks at the block index. A block without data,
+     * for example a pruned one, has no position.
+     */
+    struct RescanBlockPos
+    {
+        CBlockIndex* pindex;
+        uint256 hash;
+        boost::optional<CDiskBlockPos> pos;
+    };
+
+    using RescanBatch = std::vector<RescanBlockPos>;
+
+    RescanBlockPos GetRescanBlockPos(CBlockIndex* pindex)
+    {
+        AssertLockHeld(cs_main);
+
+        RescanBlockPos block{pindex, pindex->GetBlockHash(), boost::none};
+        if (pindex->nStatus & BLOCK_HAVE_DATA) {
+            block.pos = pindex->GetBlockPos();
+        }
+        return block;
+    }
+
+    /** Reads the blocks of a rescan batch. A block that can't be read is null. */
+    RescanBlocks ReadRescanBlocks(const RescanBatch& batch, const Consensus::Params& params)
+    {
+        RenameThread("merit-rescan");
+
+        RescanBlocks blocks;
+        blocks.reserve(batch.size());
+
+        for (const auto& entry : batch) {
+            auto block = std::make_shared<CBlock>();
+
+            // the blocks are in the active chain, so their proofs of work
+            // were checked when their headers were accepted
+            if (!entry.pos || !ReadBlockFromDisk(*block, *entry.pos, params, false)) {
+                block.reset();
+            } else if (block->GetHash() != entry.hash) {
+                error("%s: GetHash() doesn't match index for %s at %s",
+                        __func__, entry.hash.ToString(), entry.pos->ToString());
+                block.reset();
+            }
+            blocks.emplace_back(entry.pindex, std::move(block));
+        }
+
+        return blocks;
+    }
+}
+
+bool CWallet::GetIndexedAddresses(std::set<referral::AddressPair>& addresses) const
+{
+    AssertLockHeld(cs_wallet);
+
+    std::set<CKeyID> keys;
+    GetKeys(keys);
+    for (const auto& key : keys) {
+        addresses.emplace(1, key);
+    }
+
+    LOCK(cs_KeyStore);
+
+    for (const auto& script : mapScripts) {
+        // bare witness outputs aren't in the address index
+        int version;
+        std::vector<unsigned char> program;
+        if (script.second.IsWitnessProgram(version, program)) {
+            return false;
+        }
+
+        addresses.emplace(2, script.first);
+    }
+
+    for (const auto& script : mapParamScripts) {
+        addresses.emplace(3, script.first);
+    }
+
+    for (const auto& script : setWatchOnly) {
+        CTxDestination dest;
+        if (!ExtractDestination(script, dest)) {
+            return false;
+        }
+
+        uint160 hash;
+        GetUint160(dest, hash);
+        addresses.emplace(AddressTypeFromDestination(dest), hash);
+    }
+
+    return true;
+}
+
+void CWallet::GetReferralHeights(int start_height, std::set<int>& heights) const
+{
+    AssertLockHeld(cs_main);
+    AssertLockHeld(cs_wallet);
+
+    std::set<uint256> hashes;
+    for (const auto& rtx : mapWalletRTx) {
+        hashes.insert(rtx.first);
+    }
+
+    // referrals beaconed under our root referral are ours too
+    if (const auto root = GetRootReferral()) {
+        for (const auto& child : prefviewdb->GetChildren(root->GetAddress())) {
+            if (const auto ref = prefviewcache->GetReferral(child)) {
+                hashes.insert(ref->GetHash());
+            }
+        }
+    }
+
+    for (const auto& hash : hashes) {
+        referral::ReferralRef ref;
+        uint256 hash_block;
+        if (!GetReferral(hash, ref, hash_block) || hash_block.IsNull()) {
+            continue;
+        }
+
+        const auto it = mapBlockIndex.find(hash_block);
+        if (it != mapBlockIndex.end() && chainActive.Contains(it->second) &&
+                it->second->nHeight >= start_height) {
+            heights.insert(it->second->nHeight);
+        }
+    }
+}
+
+void CWallet::GetAddressHeights(
+        const std::set<referral::AddressPair>& addresses,
+        int start_height,
+        std::set<int>& heights) const
+{
+    AssertLockHeld(cs_main);
+
+    const int end_height = chainActive.Height();
+    for (const auto& address : addresses) {
+        for (bool invite : {false, true}) {
+            std::vector<std::pair<CAddressIndexKey, CAmount>> activity;
+            if (!GetAddressIndex(address.second, address.first, invite, activity, start_height, end_height)) {
+                continue;
+            }
+
+            for (const auto& entry : activity) {
+                const auto height = entry.first.blockHeight;
+                if (height >= start_height && height <= end_height) {
+                    heights.insert(height);
+                }
+            }
+        }
+    }
+}
+
 /**
  * Scan the block chain (starting in pindexStart) for transactions
  * from or to us. If fUpdate is true, found transactions that already
  * exist in the wallet will be updated.
  *
+ * With -rescanindex, only the blocks the address index lists for the
+ * wallet's addresses are read. Otherwise blocks are read in batches on a
+ * background thread while the previous batch is scanned, and cs_main is
+ * released between batches unless the caller holds it.
+ *
  * Returns null if scan was successful. Otherwise, if a complete rescan was not
- * possible (due to pruning or corruption), returns pointer to the most recent
- * block that could not be scanned.
+ * possible (due to pruning, corruption or a reorg), returns pointer to the
+ * most recent block that could not be scanned.
  */
 CBlockIndex* CWallet::ScanForWalletTransactions(CBlockIndex* pindexStart, bool fUpdate)
 {
     int64_t nNow = GetTime();
     const CChainParams& chainParams = Params();
 
-    CBlockIndex* pindex = pindexStart;
+    const int start_height = pindexStart->nHeight;
+    bool use_index = gArgs.GetBoolArg("-rescanindex", DEFAULT_RESCAN_INDEX);
+
+    // Heights left to scan and addresses already looked up when scanning
+    // through the address index.
+    std::set<int> index_heights;
+    std::set<referral::AddressPair> index_addresses;
+
+    if (use_index) {
+        LOCK2(cs_main, cs_wallet);
+        if (GetIndexedAddresses(index_addresses)) {
+            GetAddressHeights(index_addresses, start_height, index_heights);
+            GetReferralHeights(start_height, index_heights);
+            LogPrintf("%s: Rescanning %u blocks found in the address index\n", __func__, index_heights.size());
+        } else {
+            LogPrintf("%s: Wallet has scripts the address index doesn't cover, rescanning every block\n", __func__);
+            use_index = false;
+        }
+    }
+
+    // Collects the next batch of blocks to scan after last, or from
+    // pindexStart if last is null.
+    auto next_batch = [&](const CBlockIndex* last) {
+        AssertLockHeld(cs_main);
+        RescanBatch batch;
+
+        if (!use_index) {
+            CBlockIndex* pindex = last ? chainActive.Next(last) : pindexStart;
+            for (; pindex && batch.size() < RESCAN_BATCH_SIZE; pindex = chainActive.Next(pindex)) {
+                batch.push_back(GetRescanBlockPos(pindex));
+            }
+            return batch;
+        }
+
+        // Topping up the keypool while scanning adds keys that need to be
+        // looked up too.
+        if (index_heights.empty() && last) {
+            LOCK(cs_wallet);
+            std::set<referral::AddressPair> addresses;
+            if (GetIndexedAddresses(addresses)) {
+                std::set<referral::AddressPair> added;
+                std::set_difference(
+                        addresses.begin(), addresses.end(),
+                        index_addresses.begin(), index_addresses.end(),
+                        std::inserter(added, added.end()));
+                GetAddressHeights(added, start_height, index_heights);
+                index_addresses.insert(added.begin(), added.end());
+            }
+        }
+
+        while (!index_heights.empty() && batch.size() < RESCAN_BATCH_SIZE) {
+            if (CBlockIndex* pindex = chainActive[*index_heights.begin()]) {
+                batch.push_back(GetRescanBlockPos(pindex));
+            }
+            index_heights.erase(index_heights.begin());
+        }
+        return batch;
+    };
+
     CBlockIndex* ret = nullptr;
+    double dProgressStart;
+    double dProgressTip;
+    RescanBatch indexes;
     {
-        LOCK2(cs_main, cs_wallet);
+        LOCK(cs_main);
         fAbortRescan = false;
         fScanningWallet = true;
 
         ShowProgress(_("Rescanning..."), 0); // show rescan progress in GUI as dialog or on splashscreen, if -rescan on startup
-        double dProgressStart = GuessVerificationProgress(chainParams.TxData(), pindex);
-        double dProgressTip = GuessVerificationProgress(chainParams.TxData(), chainActive.Tip());
-        while (pindex && !fAbortRescan)
-        {
+        dProgressStart = GuessVerificationProgress(chainParams.TxData(), pindexStart);
+        dProgressTip = GuessVerificationProgress(chainParams.TxData(), chainActive.Tip());
+        indexes = next_batch(nullptr);
+    }
+
+    std::future<RescanBlocks> pending;
+    if (!indexes.empty()) {
+        pending = std::async(std::launch::async, ReadRescanBlocks, indexes, std::cref(chainParams.GetConsensus()));
+    }
+
+    CBlockIndex* pindex = nullptr;
+    while (!indexes.empty() && !fAbortRescan)
+    {
+        const auto blocks = pending.get();
+
+        LOCK2(cs_main, cs_wallet);
+
+        // read the next batch while this one is scanned
+        indexes = next_batch(blocks.back().first);
+        if (!indexes.empty()) {
+            pending = std::async(std::launch::async, ReadRescanBlocks, indexes, std::cref(chainParams.GetConsensus()));
+        }
+
+        for (const auto& entry : blocks) {
+            pindex = entry.first;
+
+            if (fAbortRescan) {
+                break;
+            }
+
+            // Stop if the block was disconnected since the batch was read.
+            if (!chainActive.Contains(pindex)) {
+                ret = pindex;
+                fAbortRescan = true;
+                break;
+            }
+
             if (pindex->nHeight % 100 == 0 && dProgressTip - dProgressStart > 0.0)
                 ShowProgress(_("Rescanning..."), std::max(1, std::min(99, (int)((GuessVerificationProgress(chainParams.TxData(), pindex) - dProgressStart) / (dProgressTip - dProgressStart) * 100))));
             if (GetTime() >= nNow + 60) {
@@ -2313,31 +2589,33 @@ CBlockIndex* CWallet::ScanForWalletTransactions(CBlockIndex* pindexStart, bool f
                 LogPrintf("Still rescanning. At block %d. Progress=%f\n", pindex->nHeight, GuessVerificationProgress(chainParams.TxData(), pindex));
             }
 
-            CBlock block;
-            if (ReadBlockFromDisk(block, pindex, Params().GetConsensus())) {
-                for (size_t i = 0; i < block.vtx.size(); ++i) {
-                    AddToWalletIfInvolvingMe(block.vtx[i], pindex, i, fUpdate);
-                }
+            const auto& block = entry.second;
+            if (!block) {
+                ret = pindex;
+                continue;
+            }
 
-                for (size_t i = 0; i < block.invites.size(); ++i) {
-                    AddToWalletIfInvolvingMe(block.invites[i], pindex, i, fUpdate);
-                }
+            for (size_t i = 0; i < block->vtx.size(); ++i) {
+                AddToWalletIfInvolvingMe(block->vtx[i], pindex, i, fUpdate);
+            }
 
-                for (size_t i = 0; i < block.m_vRef.size(); ++i) {
-                    AddToWalletIfInvolvingMe(block.m_vRef[i], pindex, i, fUpdate);
-                }
-            } else {
-                ret = pindex;
+            for (size_t i = 0; i < block->invites.size(); ++i) {
+                AddToWalletIfInvolvingMe(block->invites[i], pindex, i, fUpdate);
+            }
+
+            for (size_t i = 0; i < block->m_vRef.size(); ++i) {
+                AddToWalletIfInvolvingMe(block->m_vRef[i], pindex, i, fUpdate);
             }
-            pindex = chainActive.Next(pindex);
-        }
-        if (pindex && fAbortRescan) {
-            LogPrintf("Rescan aborted at block %d. Progress=%f\n", pindex->nHeight, GuessVerificationProgress(chainParams.TxData(), pindex));
         }
-        ShowProgress(_("Rescanning..."), 100); // hide progress dialog in GUI
+    }
 
-        fScanningWallet = false;
+    if (pindex && fAbortRescan) {
+        LOCK(cs_main);
+        LogPrintf("Rescan aborted at block %d. Progress=%f\n", pindex->nHeight, GuessVerificationProgress(chainParams.TxData(), pindex));
     }
+    ShowProgress(_("Rescanning..."), 100); // hide progress dialog in GUI
+
+    fScanningWallet = false;
     return ret;
 }
 
@@ -2693,19 +2971,63 @@ void ReduceAddressAmounts(AddressAmountMap& result, const AddressAmountMap& othe
     }
 }
 
-CAmount CWallet::GetBalance(bool invite) const
+WalletBalances CWallet::TallyBalances() const
 {
-    CAmount nTotal = 0;
-    AddressAmountMap address_amounts;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (WalletTxMap::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
-        {
-            const CWalletTx* pcoin = &(*it).second;
-            if (pcoin->IsTrusted() && pcoin->IsInvite() == invite) {
-                AddressAmountMap tx_address_amounts;
-                nTotal += pcoin->GetAvailableCredit(tx_address_amounts);
-                ReduceAddressAmounts(address_amounts, tx_address_amounts);
+    AssertLockHeld(cs_main);
+    AssertLockHeld(cs_wallet);
+
+    WalletBalances balances;
+    AddressAmountMap invite_addresses;
+    AddressAmountMap unconfirmed_invite_addresses;
+
+    for (const auto& entry : mapWallet) {
+        const uint256& txHash = entry.first;
+        const CWalletTx& wtx = entry.second;
+        const bool invite = wtx.IsInvite();
+        auto& tally = invite ? balances.invites : balances.coins;
+
+        const bool trusted = wtx.IsTrusted();
+        const int depth = wtx.GetDepthInMainChain();
+        // Conflicted transactions have a negative depth, and abandoned ones
+        // only return to the mempool through SyncTransaction, which marks
+        // the balances dirty. Neither needs the mempool watched.
+        if (depth == 0 && !wtx.isAbandoned()) {
+            balances.depends_on_mempool = true;
+        }
+
+        if (trusted) {
+            AddressAmountMap tx_address_amounts;
+            tally.available += wtx.GetAvailableCredit(tx_address_amounts);
+            tally.watch_only_available += wtx.GetAvailableWatchOnlyCredit();
+            if (invite) {
+                ReduceAddressAmounts(invite_addresses, tx_address_amounts);
+            }
+        } else if (depth == 0 && wtx.InMempool()) {
+            AddressAmountMap tx_address_amounts;
+            tally.unconfirmed += wtx.GetAvailableCredit(tx_address_amounts);
+            tally.watch_only_unconfirmed += wtx.GetAvailableWatchOnlyCredit();
+            if (invite) {
+                ReduceAddressAmounts(unconfirmed_invite_addresses, tx_address_amounts);
+            }
+        }
+
+        tally.immature += wtx.GetImmatureCredit();
+        tally.watch_only_immature += wtx.GetImmatureWatchOnlyCredit();
+
+        if (trusted && wtx.tx->IsCoinBase()) {
+            for (unsigned int i = 0; i < wtx.tx->vout.size(); i++) {
+                if (!IsSpent(txHash, i)) {
+                    const CTxOut& txout = wtx.tx->vout[i];
+                    CAmount nCredit = GetCredit(txout, ISMINE_SPENDABLE);
+                    if (!MoneyRange(nCredit))
+                        throw std::runtime_error(std::string(__func__) + " : value out of range");
+
+                    if (i == 0) {
+                        balances.rewards.mining += nCredit;
+                    } else {
+                        balances.rewards.ambassador += nCredit;
+                    }
+                }
             }
         }
     }
@@ -2713,16 +3035,63 @@ CAmount CWallet::GetBalance(bool invite) const
     //If we are computing the available invite balance, we want to subtract 1 because
     //if you transfer the last uspent invite from address A to address B, you
     //will render address A unusable.
-    if(invite) {
-        nTotal = std::max<CAmount>(0, nTotal - address_amounts.size());
+    balances.invites.available =
+        std::max<CAmount>(0, balances.invites.available - invite_addresses.size());
+    balances.invites.unconfirmed =
+        std::max<CAmount>(0, balances.invites.unconfirmed - unconfirmed_invite_addresses.size());
+
+    return balances;
+}
+
+WalletBalances CWallet::GetBalances() const
+{
+    AssertLockHeld(cs_main);
+    AssertLockHeld(cs_wallet);
+
+    const uint256 tip = chainActive.Tip() ? chainActive.Tip()->GetBlockHash() : uint256{};
+    const unsigned int mempool_updates = mempool.GetTransactionsUpdated();
+
+    const bool fresh = m_balances_cached &&
+        m_balances_cached_generation == m_balances_generation &&
+        m_balances_cached_tip == tip &&
+        (!m_balances.depends_on_mempool || m_balances_cached_mempool_updates == mempool_updates);
+
+    if (fresh) {
+        if (fWalletCheckBalances) {
+            const auto scanned = TallyBalances();
+            if (!(scanned == m_balances)) {
+                LogPrintf("%s: cached balances differ from a full wallet scan, rescanning\n", __func__);
+                m_balances = scanned;
+            }
+        }
+        return m_balances;
     }
 
-    return nTotal;
+    m_balances = TallyBalances();
+    m_balances_cached = true;
+    m_balances_cached_generation = m_balances_generation;
+    m_balances_cached_tip = tip;
+    m_balances_cached_mempool_updates = mempool_updates;
+
+    return m_balances;
 }
 
-CAmount CWallet::GetANV() const
+void CWallet::MarkBalancesDirty()
+{
+    AssertLockHeld(cs_wallet);
+    m_balances_generation++;
+}
+
+CAmount CWallet::GetBalance(bool invite) const
 {
     LOCK2(cs_main, cs_wallet);
+    return GetBalances().Get(invite).available;
+}
+
+CAmount CWallet::ComputeANV() const
+{
+    AssertLockHeld(cs_main);
+    AssertLockHeld(cs_wallet);
 
     std::set<referral::Address> keys;
 
@@ -2754,128 +3123,61 @@ CAmount CWallet::GetANV() const
     return total;
 }
 
-pog::RewardsAmount CWallet::GetRewards() const
+CAmount CWallet::GetANV() const
 {
     LOCK2(cs_main, cs_wallet);
 
-    return std::accumulate(mapWallet.begin(), mapWallet.end(), pog::RewardsAmount{},
-        [this](pog::RewardsAmount& acc, const WalletTxMap::value_type& it) {
-            const CWalletTx& wtx = it.second;
-            const uint256& txHash = it.first;
-
-            if (wtx.IsTrusted() && wtx.tx->IsCoinBase()) {
-                for (unsigned int i = 0; i < wtx.tx->vout.size(); i++) {
-                    if (!IsSpent(txHash, i)) {
-                        const CTxOut& txout = wtx.tx->vout[i];
-                        CAmount nCredit = GetCredit(txout, ISMINE_SPENDABLE);
-                        if (!MoneyRange(nCredit))
-                            throw std::runtime_error(std::string(__func__) + " : value out of range");
-
-                        if (i == 0) {
-                            acc.mining += nCredit;
-                        } else {
-                            acc.ambassador += nCredit;
-                        }
-                    }
-                }
-            }
+    // ANVs only move when blocks connect, so the total holds until the tip
+    // or the wallet's keys change.
+    const uint256 tip = chainActive.Tip() ? chainActive.Tip()->GetBlockHash() : uint256{};
+    if (m_anv_cached &&
+            m_anv_cached_generation == m_balances_generation &&
+            m_anv_cached_tip == tip) {
+        return m_anv;
+    }
 
-            return acc;
-        });
+    m_anv = ComputeANV();
+    m_anv_cached = true;
+    m_anv_cached_generation = m_balances_generation;
+    m_anv_cached_tip = tip;
+
+    return m_anv;
 }
 
-CAmount CWallet::GetUnconfirmedBalance(bool invite) const
+pog::RewardsAmount CWallet::GetRewards() const
 {
-    CAmount nTotal = 0;
-    AddressAmountMap address_amounts;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (WalletTxMap::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
-        {
-            const CWalletTx* pcoin = &(*it).second;
-            if (!pcoin->IsTrusted() &&
-                    pcoin->GetDepthInMainChain() == 0 &&
-                    pcoin->InMempool() &&
-                    pcoin->IsInvite() == invite) {
-
-                AddressAmountMap tx_address_amounts;
-                nTotal += pcoin->GetAvailableCredit(tx_address_amounts);
-                ReduceAddressAmounts(address_amounts, tx_address_amounts);
-            }
-        }
-    }
+    LOCK2(cs_main, cs_wallet);
+    return GetBalances().rewards;
+}
 
-    if(invite) {
-        nTotal = std::max<CAmount>(0, nTotal - address_amounts.size());
-    }
-    return nTotal;
+CAmount CWallet::GetUnconfirmedBalance(bool invite) const
+{
+    LOCK2(cs_main, cs_wallet);
+    return GetBalances().Get(invite).unconfirmed;
 }
 
 CAmount CWallet::GetImmatureBalance(bool invite) const
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (WalletTxMap::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
-        {
-            const CWalletTx* pcoin = &(*it).second;
-            if(pcoin->IsInvite() == invite) {
-                nTotal += pcoin->GetImmatureCredit();
-            }
-        }
-    }
-    return nTotal;
+    LOCK2(cs_main, cs_wallet);
+    return GetBalances().Get(invite).immature;
 }
 
 CAmount CWallet::GetWatchOnlyBalance(bool invite) const
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (WalletTxMap::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
-        {
-            const CWalletTx* pcoin = &(*it).second;
-            if (pcoin->IsTrusted() && pcoin->IsInvite() == invite) {
-                nTotal += pcoin->GetAvailableWatchOnlyCredit();
-            }
-        }
-    }
-
-    return nTotal;
+    LOCK2(cs_main, cs_wallet);
+    return GetBalances().Get(invite).watch_only_available;
 }
 
 CAmount CWallet::GetUnconfirmedWatchOnlyBalance(bool invite) const
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (WalletTxMap::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
-        {
-            const CWalletTx* pcoin = &(*it).second;
-            if (!pcoin->IsTrusted() &&
-                    pcoin->GetDepthInMainChain() == 0 &&
-                    pcoin->InMempool() &&
-                    pcoin->IsInvite() == invite)
-                nTotal += pcoin->GetAvailableWatchOnlyCredit();
-        }
-    }
-    return nTotal;
+    LOCK2(cs_main, cs_wallet);
+    return GetBalances().Get(invite).watch_only_unconfirmed;
 }
 
 CAmount CWallet::GetImmatureWatchOnlyBalance(bool invite) const
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (WalletTxMap::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
-        {
-            const CWalletTx* pcoin = &(*it).second;
-            if(pcoin->IsInvite() == invite) {
-                nTotal += pcoin->GetImmatureWatchOnlyCredit();
-            }
-        }
-    }
-    return nTotal;
+    LOCK2(cs_main, cs_wallet);
+    return GetBalances().Get(invite).watch_only_immature;
 }
 
 // Calculate total balance in a different way from GetBalance. The biggest
@@ -4314,6 +4616,7 @@ bool CWallet::SetAddressBook(const CTxDestination& address, const std::string& s
         mapAddressBook[address].name = strName;
         if (!strPurpose.empty()) /* update purpose only if requested */
             mapAddressBook[address].purpose = strPurpose;
+        MarkBalancesDirty();
     }
     NotifyAddressBookChanged(this, address, strName, ::IsMine(*this, address) != ISMINE_NO,
                              strPurpose, (fUpdated ? CT_UPDATED : CT_NEW) );
@@ -4334,6 +4637,7 @@ bool CWallet::DelAddressBook(const CTxDestination& address)
             CWalletDB(*dbw).EraseDestData(strAddress, item.first);
         }
         mapAddressBook.erase(address);
+        MarkBalancesDirty();
     }
 
     NotifyAddressBookChanged(this, address, "", ::IsMine(*this, address) != ISMINE_NO, "", CT_DELETED);
@@ -45,6 +45,7 @@ extern CFeeRate payTxFee;
 extern unsigned int nTxConfirmTarget;
 extern bool bSpendZeroConfChange;
 extern bool fWalletRbf;
+extern bool fWalletCheckBalances;
 
 static const unsigned int DEFAULT_KEYPOOL_SIZE = 10;
 //! -paytxfee default
@@ -71,6 +72,10 @@ static const unsigned int DEFAULT_TX_CONFIRM_TARGET = 6;
 static const bool DEFAULT_WALLET_RBF = false;
 static const bool DEFAULT_WALLETBROADCAST = true;
 static const bool DEFAULT_DISABLE_WALLET = false;
+//! -rescanindex default
+static const bool DEFAULT_RESCAN_INDEX = false;
+//! -walletcheckbalances default
+static const bool DEFAULT_WALLET_CHECK_BALANCES = false;
 
 //! how many blocks should be verified before wallet can be unlocked
 static const unsigned int CHAIN_DEPTH_TO_UNLOCK_WALLET = 0;
@@ -711,6 +716,48 @@ private:
 
 using WalletTxMap = std::map<uint256, CWalletTx>;
 using WalletReferralsMap = std::map<uint256, referral::ReferralTx>;
+
+/** Wallet totals by category, tallied in a single pass over the wallet transactions. */
+struct WalletBalances
+{
+    struct Tally
+    {
+        CAmount available = 0;
+        CAmount unconfirmed = 0;
+        CAmount immature = 0;
+        CAmount watch_only_available = 0;
+        CAmount watch_only_unconfirmed = 0;
+        CAmount watch_only_immature = 0;
+
+        bool operator==(const Tally& o) const
+        {
+            return available == o.available &&
+                unconfirmed == o.unconfirmed &&
+                immature == o.immature &&
+                watch_only_available == o.watch_only_available &&
+                watch_only_unconfirmed == o.watch_only_unconfirmed &&
+                watch_only_immature == o.watch_only_immature;
+        }
+    };
+
+    Tally coins;
+    Tally invites;
+    pog::RewardsAmount rewards;
+
+    //! Whether the mempool status of an unconfirmed, not abandoned transaction went into the totals.
+    bool depends_on_mempool = false;
+
+    const Tally& Get(bool invite) const { return invite ? invites : coins; }
+
+    bool operator==(const WalletBalances& o) const
+    {
+        return coins == o.coins &&
+            invites == o.invites &&
+            rewards.mining == o.rewards.mining &&
+            rewards.ambassador == o.rewards.ambassador;
+    }
+};
+
 /**
  * A CWallet is an extension of a keystore, which also maintains a set of transactions and balances,
  * and provides the ability to create new transactions.
@@ -793,6 +840,34 @@ private:
 
     std::unique_ptr<CWalletDBWrapper> dbw;
 
+    /**
+     * Balance and ANV totals are cached until the next event that can move
+     * them. m_balances_generation is bumped by every such event; the cached
+     * totals also record the chain tip, and the mempool update count when
+     * unconfirmed transactions went into them.
+     *
+     * The totals are not kept as running sums. Which category a transaction
+     * counts in depends on its depth, on whether its inputs are trusted, on
+     * spends by other transactions and on the mempool, and every new tip can
+     * mature coinbases without any wallet event. So the first query after a
+     * change rescans mapWallet, and the polling between blocks is served
+     * from the cache.
+     */
+    uint64_t m_balances_generation;
+    mutable bool m_balances_cached;
+    mutable uint64_t m_balances_cached_generation;
+    mutable uint256 m_balances_cached_tip;
+    mutable unsigned int m_balances_cached_mempool_updates;
+    mutable WalletBalances m_balances;
+
+    mutable bool m_anv_cached;
+    mutable uint64_t m_anv_cached_generation;
+    mutable uint256 m_anv_cached_tip;
+    mutable CAmount m_anv;
+
+    void MarkBalancesDirty();
+    CAmount ComputeANV() const;
+
 public:
     /*
      * Main wallet lock.
@@ -864,6 +939,13 @@ public:
         nRelockTime = 0;
         fAbortRescan = false;
         fScanningWallet = false;
+        m_balances_generation = 0;
+        m_balances_cached = false;
+        m_balances_cached_generation = 0;
+        m_balances_cached_mempool_updates = 0;
+        m_anv_cached = false;
+        m_anv_cached_generation = 0;
+        m_anv = 0;
     }
 
     WalletTxMap mapWallet;
@@ -1039,11 +1121,23 @@ public:
     bool AddToWalletIfInvolvingMe(const referral::ReferralRef& rtx, const CBlockIndex* pIndex, int posInBlock, bool fUpdate);
     int64_t RescanFromTime(int64_t startTime, bool update);
     CBlockIndex* ScanForWalletTransactions(CBlockIndex* pindexStart, bool fUpdate = false);
+
+    /** Addresses the address index records for the wallet's keys and scripts.
+     * Returns false if the wallet has scripts the index can't find. */
+    bool GetIndexedAddresses(std::set<referral::AddressPair>& addresses) const;
+    /** Heights from start_height on where the address index saw the addresses */
+    void GetAddressHeights(const std::set<referral::AddressPair>& addresses, int start_height, std::set<int>& heights) const;
+    /** Heights from start_height on holding the wallet's referrals */
+    void GetReferralHeights(int start_height, std::set<int>& heights) const;
     void ReacceptWalletTransactions();
     void ResendWalletTransactions(int64_t nBestBlockTime, CConnman* connman) override;
 
     // ResendWalletTransactionsBefore may only be called if fBroadcastTransactions!
     std::vector<uint256> ResendWalletTransactionsBefore(int64_t nTime, CConnman* connman);
+    /** Full scan of the wallet transactions for every balance category */
+    WalletBalances TallyBalances() const;
+    /** Balances from the cached tally, rescanned only when something changed */
+    WalletBalances GetBalances() const;
     CAmount GetBalance(bool invite = false) const;
     CAmount GetUnconfirmedBalance(bool invite = false) const;
     CAmount GetImmatureBalance(bool invite = false) const;